@@ -0,0 +1,36 @@
+/* nanoatomic.h */
+
+#ifndef __NANOATOMIC_H__
+#define __NANOATOMIC_H__
+
+/*
+ *  Minimal atomics for single producer / single consumer rings and
+ *  counters shared between the engine, helper threads and the GUI.
+ *  Indices are plain volatile words (naturally atomic to load & store);
+ *  the barriers order the data accesses around them.
+ */
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#define NANO_BARRIER()			MemoryBarrier()
+#define NANO_ATOMIC_INC(p)		InterlockedIncrement((volatile LONG*) (p))
+#define NANO_ATOMIC_ADD(p, n)	InterlockedExchangeAdd((volatile LONG*) (p), (LONG) (n))
+#else
+#define NANO_BARRIER()			__sync_synchronize()
+#define NANO_ATOMIC_INC(p)		__sync_add_and_fetch((p), 1)
+#define NANO_ATOMIC_ADD(p, n)	__sync_fetch_and_add((p), (n))
+#endif
+
+/* Load index published by the other side, then read what it guards */
+#define NANO_LOAD_ACQUIRE(v)	nanoLoadAcquire(&(v))
+/* Write the data guarded by index, then publish it */
+#define NANO_STORE_RELEASE(v, x)	{ NANO_BARRIER(); (v) = (x); }
+
+static __inline unsigned nanoLoadAcquire(volatile unsigned* v)
+{
+	unsigned x = *v;
+	NANO_BARRIER();
+	return x;
+}
+
+#endif /* __NANOATOMIC_H__ */
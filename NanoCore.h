@@ -0,0 +1,438 @@
+/* nanocore.h */
+
+/*
+ *  Nano CPU core template.
+ *
+ *  This file is not a normal header: NanoCpu.c includes it once for each
+ *  supported word width to build a separate, fully specialised core.
+ *  The following must be defined before each inclusion:
+ *
+ *      CORE_BITS       word width in bits (16 or 32)
+ *      CORE_WORD       unsigned word type
+ *      CORE_SWORD      signed word type
+ *      CORE_MSB        most significant bit of a word
+ *      CORE(name)      name with width suffix appended
+ */
+
+#define CORE_SIGN(w)    ((w) & CORE_MSB)
+#define CORE_HALF_MASK  ((CORE_WORD) ~0 >> (CORE_BITS / 2))
+
+/* Cycles for a bus access; a bus error (negative) still takes one */
+#define CORE_BUS_CYCLES(c)  ((c) > 0 ? (c) : 1)
+
+/* Fetch byte at addr (sign extended). */
+static CORE_WORD CORE(NanoLoadByte)(NANO_CPU* p, CORE_WORD addr)
+{
+    NANO_SHORT data = MEM_UNMAPPED;
+    int cycles = MemFastReadByte(addr, &data);
+	if ((addr & 1) == 0)
+		data = data << 8;
+    p->cycles += CORE_BUS_CYCLES(cycles);
+	// Sign extend into lower 8 bits
+	return (CORE_WORD) (CORE_SWORD) ((signed short) data >> 8);
+}
+
+/* Fetch word at addr. */
+static CORE_WORD CORE(NanoLoadWord)(NANO_CPU* p, CORE_WORD addr)
+{
+    NANO_SHORT data = MEM_UNMAPPED;
+    int cycles = MemFastReadWord(addr, &data);
+    p->cycles += CORE_BUS_CYCLES(cycles);
+    return data;
+}
+
+/* Store byte at addr. */
+static void CORE(NanoStoreByte)(NANO_CPU* p, CORE_WORD addr, CORE_WORD data)
+{
+    int cycles = MemWriteByte(addr, (NANO_SHORT) data);
+    p->cycles += CORE_BUS_CYCLES(cycles);
+}
+
+/* Store word at addr. */
+static void CORE(NanoStoreWord)(NANO_CPU* p, CORE_WORD addr, CORE_WORD data)
+{
+    int cycles = MemFastWriteWord(addr, (NANO_SHORT) data);
+    p->cycles += CORE_BUS_CYCLES(cycles);
+}
+
+static void CORE(NanoAluOp)(NANO_CPU* p, NANO_ALU alu, int Rx, CORE_WORD a, CORE_WORD b)
+{
+    CORE_WORD result = 0;
+    CORE_WORD cond;
+    CORE_WORD carry;
+    int overflow = -1;      /* -1: derive from signs of a, b & result */
+    int shift;
+    uint64_t product;
+
+    carry = (p->ccr & NANO_C) ? 1 : 0;
+
+    switch (alu)
+	{
+    case ALU_ADD:
+		carry = 0;
+    case ALU_ADC:   /* Add w/ Carry */
+        ALU_ADDSUB(result, a, b, carry);
+        WRITE_REG(p, Rx, result);
+        break;
+	case ALU_SUB:
+		carry = 0;
+    case ALU_SBC:   /* Subtract w/ Carry */
+        carry = carry ? 0 : 1;
+        b = ~b;
+        ALU_ADDSUB(result, a, b, carry);
+        carry = !carry;
+        WRITE_REG(p, Rx, result);
+        break;
+	case ALU_RSUB:
+		result = b - a;
+		WRITE_REG(p, Rx, result);
+		break;
+    case ALU_AND:   /* And */
+        result = a & b;
+        WRITE_REG(p, Rx, result);
+        break;
+    case ALU_OR:    /* Or */
+        result = a | b;
+        WRITE_REG(p, Rx, result);
+        break;
+    case ALU_XOR:   /* eXclusive Or */
+        result = a ^ b;
+        WRITE_REG(p, Rx, result);
+        break;
+    case ALU_MUL:   /* MULtiply: C,V = high word non-zero */
+        product = (uint64_t) a * b;
+        result = (CORE_WORD) product;
+        carry = (product >> CORE_BITS) != 0;
+        overflow = carry;
+        p->cycles += MUL_CYCLES;
+        WRITE_REG(p, Rx, result);
+        break;
+    case ALU_DIV:   /* unsigned DIVide: V = divide by zero */
+        if (b == 0)
+        {
+            result = (CORE_WORD) ~0;
+            overflow = 1;
+        }
+        else
+        {
+            result = a / b;
+            overflow = 0;
+        }
+        carry = 0;
+        p->cycles += DIV_CYCLES(CORE_BITS);
+        WRITE_REG(p, Rx, result);
+        break;
+    case ALU_ASR:   /* Arithmetic Shift Right: C = last bit out */
+        shift = b & SHIFT_MASK;
+        if (shift == 0)
+        {
+            result = a;
+            carry = 0;
+        }
+        else if (shift >= CORE_BITS)
+        {
+            result = CORE_SIGN(a) ? (CORE_WORD) ~0 : 0;
+            carry = CORE_SIGN(a) ? 1 : 0;
+        }
+        else
+        {
+            result = (CORE_WORD) ((CORE_SWORD) a >> shift);
+            carry = (a >> (shift - 1)) & 1;
+        }
+        overflow = 0;
+        WRITE_REG(p, Rx, result);
+        break;
+    case ALU_LSR:   /* Logical Shift Right: C = last bit out */
+        shift = b & SHIFT_MASK;
+        if (shift == 0)
+        {
+            result = a;
+            carry = 0;
+        }
+        else if (shift >= CORE_BITS)
+        {
+            result = 0;
+            carry = (shift == CORE_BITS) ? (a >> (CORE_BITS - 1)) & 1 : 0;
+        }
+        else
+        {
+            result = a >> shift;
+            carry = (a >> (shift - 1)) & 1;
+        }
+        overflow = 0;
+        WRITE_REG(p, Rx, result);
+        break;
+    case LINK:      /* Rx = PC (return address), flags unchanged */
+        WRITE_REG(p, Rx, p->pc);
+        return;
+    case LD_IMM:    /* upper half of Rx = lower half of Ry */
+        result = (CORE_WORD) ((b << (CORE_BITS / 2)) | (a & CORE_HALF_MASK));
+        carry = 0;
+        overflow = 0;
+        WRITE_REG(p, Rx, result);
+        break;
+    default:        /* reserved CX, DX */
+        NanoIllegalOpcode(p);
+        return;
+    }
+    /* Update Condition Codes based on result, a & b */
+    cond = (result & CORE_MSB) ? NANO_N : 0;
+
+    /* overflow if the sign of the result is different from the signs of both operands */
+    if (overflow < 0)
+        overflow = CORE_SIGN(a ^ result) && CORE_SIGN(b ^ result);
+    if (overflow)
+        cond |= NANO_V;
+
+    if (result == 0)
+        cond |= NANO_Z;
+
+    if (carry)
+        cond |= NANO_C;
+	// Update condition codes
+	p->ccr = cond;
+}
+
+/*
+ *  ===== NanoExecInst =====
+ *      Fetch, decode and execute a single instruction at p->pc.
+ */
+static void CORE(NanoExecInst)(NANO_CPU* p)
+{
+    /* Fetch 16-bit instruction opcode */
+    NANO_INST opc = MEM_UNMAPPED;
+    CORE_WORD addr;
+    CORE_WORD data;
+    int Rx,Ry,Rz;
+
+    int cycles = MemFastFetchWord(p->pc, &opc);
+    p->cycles += CORE_BUS_CYCLES(cycles);
+
+    p->pc = (CORE_WORD) (p->pc + 2);
+
+	/* Decode (register) fields */
+	Rx = OPC_RX(opc);
+	Ry = OPC_RY(opc);
+	Rz = OPC_RZ(opc);
+
+    switch (GET_OPC(opc))
+	{
+    case OPC_ADD_IMM:
+		p->ccr &= ~NANO_C; // Clear CARRY
+        data = ((p)->prefix << 4) | OPC_IMM4(opc);
+
+        CORE(NanoAluOp)(p, ALU_ADC, Rx, p->reg[Ry], data);
+        p->prefix = NO_PREFIX;
+        break;
+    case OPC_SUB_IMM:
+		p->ccr &= ~NANO_C; // Clear CARRY
+        data = ((p)->prefix << 4) | OPC_IMM4(opc);
+
+        CORE(NanoAluOp)(p, ALU_ADC, Rx, p->reg[Ry], data);
+        p->prefix = NO_PREFIX;
+        break;
+	case OPC_ADC_IMM:
+		data = ((p)->prefix << 4) | OPC_IMM4(opc);
+
+		CORE(NanoAluOp)(p, ALU_ADC, Rx, p->reg[Ry], data);
+		p->prefix = NO_PREFIX;
+		break;
+	case OPC_SBC_IMM:
+		data = ((p)->prefix << 4) | OPC_IMM4(opc);
+
+		CORE(NanoAluOp)(p, ALU_SBC, Rx, p->reg[Ry], data);
+		p->prefix = NO_PREFIX;
+		break;
+	case OPC_RSUB_IMM:
+		p->ccr &= ~NANO_C; // Clear CARRY
+		data = ((p)->prefix << 4) | OPC_IMM4(opc);
+
+		CORE(NanoAluOp)(p, ALU_RSUB, Rx, p->reg[Ry], data);
+		p->prefix = NO_PREFIX;
+		break;
+	case OPC_AND_IMM:
+		p->ccr &= ~NANO_C; // Clear CARRY
+        data = ((p)->prefix << 4) | OPC_IMM4(opc);
+
+        CORE(NanoAluOp)(p, ALU_AND, Rx, p->reg[Ry], data);
+        p->prefix = NO_PREFIX;
+        break;
+    case OPC_OR_IMM:
+		p->ccr &= ~NANO_C; // Clear CARRY
+        data = ((p)->prefix << 4) | OPC_IMM4(opc);
+
+        CORE(NanoAluOp)(p, ALU_OR, Rx, p->reg[Ry], data);
+        p->prefix = NO_PREFIX;
+        break;
+    case OPC_XOR_IMM:
+		p->ccr &= ~NANO_C; // Clear CARRY
+        data = ((p)->prefix << 4) | OPC_IMM4(opc);
+
+        CORE(NanoAluOp)(p, ALU_XOR, Rx, p->reg[Ry], data);
+        p->prefix = NO_PREFIX;
+        break;
+    case OPC_ALU_REG:
+        CORE(NanoAluOp)(p, Rz, Rx, p->reg[Rx], p->reg[Ry]);
+        p->prefix = NO_PREFIX;
+        break;
+	case OPC_LB_OFF:
+		addr = p->reg[Ry] + OPC_OFF4(opc)*2;
+		data = CORE(NanoLoadByte)(p, addr);
+		WRITE_REG(p, Rx, data);
+		break;
+	case OPC_SB_OFF:
+		addr = p->reg[Ry] + OPC_OFF4(opc);
+		data = p->reg[Rx];
+		CORE(NanoStoreByte)(p, addr, data);
+		break;
+	case OPC_MOV_IMM:
+		p->ccr &= ~NANO_C; // Clear CARRY
+		data = ((p)->prefix << 8) | OPC_IMM8(opc);
+		WRITE_REG(p, Rx, data);
+		p->prefix = NO_PREFIX;
+		break;
+	case OPC_LW_OFF:
+		addr = p->reg[Ry] + OPC_OFF4(opc);
+		if (addr & 1)
+		{
+			// Load Byte
+			data = CORE(NanoLoadByte)(p, addr);
+		}
+		else
+		{
+			data = CORE(NanoLoadWord)(p, addr);
+		}
+		WRITE_REG(p, Rx, data);
+		break;
+	case OPC_SW_OFF:
+		addr = p->reg[Ry] + OPC_OFF4(opc)*2;
+		data = p->reg[Rx];
+		if (addr & 1)
+		{
+			CORE(NanoStoreByte)(p, addr, data);
+		}
+		else
+		{
+			CORE(NanoStoreWord)(p, addr, data);
+		}
+		break;
+    case OPC_BRANCH:
+	{
+        int br = NanoTestCond(p, OPC_COND(opc));
+        if (br) {
+            p->pc = (CORE_WORD) (p->pc + 2*SIGN_EXT(OPC_IMM8(opc), 0x80));
+            p->cycles += 2;
+        }
+        break;
+    }
+    case OPC_IMM:
+        p->prefix = (CORE_WORD) ((p->prefix << 12) | OPC_IMM12(opc));
+        break;
+    default:
+        NanoIllegalOpcode(p);
+        break;
+    }
+}
+
+/*
+ *  ===== NanoSimInst =====
+ *      Simulate one or more CPU instructions. Note: prefixes are treated as
+ *  separate instructions to mimic the behaviour of the hardware.
+ */
+static int CORE(NanoSimInst)(NANO_CPU* p, NANO_STEP step)
+{
+    CORE_WORD breakpt;
+    int count = 1000000;
+    switch (step)
+    {
+    case NANO_STEP_OVER:
+        breakpt = (CORE_WORD) (p->pc + InstLength(p->pc));
+        break;
+    case NANO_STEP_OUT:
+        breakpt = p->reg[15];
+        break;
+    default:
+        breakpt = 0;
+    }
+    SchedAttach(&p->cycles);
+    cpuState = NANO_RUN;
+    while (cpuState == NANO_RUN) {
+        CORE(NanoExecInst)(p);
+        SCHED_POLL(p->cycles);
+        VCD_CHANGE(VCD_PC, p->pc);
+
+        /* Stop on breakpoint(s) or single step */
+        if (p->pc == breakpt || p->pc == p->breakpoint ||
+            step == NANO_STEP_INTO || --count == 0)
+            break;
+    }
+    SchedAttach(NULL);
+    return 0;
+}
+
+/* NanoRunInst while a waveform is being recorded: PC traced per instruction */
+static long CORE(NanoTraceInst)(NANO_CPU* p, long count)
+{
+    long n = 0;
+    SchedAttach(&p->cycles);
+    while (n < count)
+    {
+        CORE(NanoExecInst)(p);
+        ++n;
+        SCHED_POLL(p->cycles);
+        VcdChange(VCD_PC, p->pc);
+        if (p->pc == p->breakpoint)
+            break;
+    }
+    SchedAttach(NULL);
+    return n;
+}
+
+/*
+ *  ===== NanoRunInst =====
+ *      Fast engine: execute up to count instructions without the
+ *  per-instruction step bookkeeping of NanoSimInst.  Scheduled events are
+ *  only checked between budgets of instructions that cannot reach the
+ *  next event.  An instruction that branches to itself is repeated in
+ *  one go up to the next event (same state as stepping it).  Stops early
+ *  when the breakpoint is reached.  Returns number of instructions
+ *  executed.
+ */
+static long CORE(NanoRunInst)(NANO_CPU* p, long count)
+{
+    long n = 0;
+    if (vcdActive)
+        return CORE(NanoTraceInst)(p, count);
+    SchedAttach(&p->cycles);
+    while (n < count)
+    {
+        long end = n + SchedBudget(p->cycles, count - n);
+        while (n < end)
+        {
+            CORE_WORD pc = (CORE_WORD) p->pc;
+            NANO_TIME start = p->cycles;
+            CORE(NanoExecInst)(p);
+            ++n;
+            if (p->pc == p->breakpoint)
+            {
+                count = n;
+                break;
+            }
+            if (p->pc == pc)
+            {
+                /* idle loop: skip ahead to the next event */
+                NANO_TIME cycles = p->cycles - start;
+                long skip = SchedIdle(p->cycles, cycles, count - n);
+                p->cycles += cycles * skip;
+                n += skip;
+                break;
+            }
+        }
+    }
+    SchedRun(p->cycles);
+    SchedAttach(NULL);
+    return n;
+}
+
+#undef CORE_SIGN
+#undef CORE_HALF_MASK
@@ -0,0 +1,209 @@
+#include <stdlib.h>
+#include <string.h>
+#include "NanoCosim.h"
+#include "NanoMem.h"
+#include "NanoPlugin.h"
+
+static NANO_RETIRE* cosimStore = NULL;		/* record taking stores */
+static NANO_REG cosimRegs[COSIM_BLOCK][16];	/* registers after each instruction */
+
+static void CosimTrace(NANO_ADDR addr, NANO_SHORT data, int kind)
+{
+	/* the model has its own devices: compare stores to memory only */
+	if (kind == MEM_TRACE_READ || cosimStore == NULL || memPage[MEM_PAGE_NUM(addr)].ram == NULL)
+		return;
+	cosimStore->flags |= RETIRE_MEM;
+	cosimStore->addr = addr;
+	cosimStore->data = data;
+	if (kind == MEM_TRACE_BYTE)
+	{
+		cosimStore->flags |= RETIRE_BYTE;
+		cosimStore->data &= 0xFF;
+	}
+}
+
+/*
+ *  ===== NanoCosimInit =====
+ *      Load the RTL model at path and start it from the current memory
+ *  and the state in *p.  Returns 0, or -1 if the model cannot be loaded.
+ */
+int NanoCosimInit(NANO_COSIM* c, const char* path, const NANO_CPU* p)
+{
+	NANO_RTL_INIT init;
+	NANO_SHORT* image;
+
+	memset(c, 0, sizeof(NANO_COSIM));
+	image = (NANO_SHORT*) malloc(NANO_MEM_WORDS * sizeof(NANO_SHORT));
+	if (image == NULL)
+		return -1;
+	c->lib = NanoLibOpen(path);
+	if (c->lib == NULL)
+	{
+		free(image);
+		return -1;
+	}
+	init = (NANO_RTL_INIT) NanoLibSymbol(c->lib, NANO_RTL_ENTRY);
+	c->rtl = (init != NULL) ? init(p->bits) : NULL;
+	if (c->rtl == NULL || c->rtl->version != NANO_RTL_VERSION)
+	{
+		free(image);
+		NanoCosimFree(c);
+		return -1;
+	}
+	MemSaveImage(image);
+	c->rtl->load(c->rtl->ctx, image, NANO_MEM_WORDS);
+	c->rtl->reset(c->rtl->ctx, p->pc);
+	free(image);
+	return 0;
+}
+
+void NanoCosimFree(NANO_COSIM* c)
+{
+	if (c->rtl != NULL && c->rtl->close != NULL)
+		c->rtl->close(c->rtl->ctx);
+	c->rtl = NULL;
+	if (c->lib != NULL)
+		NanoLibClose(c->lib);
+	c->lib = NULL;
+}
+
+/* Interpreter side of one block: step until a change of flow */
+static int CosimStepBlock(NANO_COSIM* c, NANO_CPU* p, int max)
+{
+	const NANO_CORE* core = NanoGetCore(p->bits);
+	int n = 0;
+
+	while (n < max)
+	{
+		NANO_RETIRE* r = &c->sim[n];
+		NANO_REG before[16];
+		int i;
+
+		memset(r, 0, sizeof(NANO_RETIRE));
+		memcpy(before, p->reg, sizeof(before));
+		r->pc = p->pc;
+		MemReadWord(p->pc, &r->opc);
+		cosimStore = r;
+		core->SimInst(p, NANO_STEP_INTO);
+		cosimStore = NULL;
+		for (i = 0; i < 16; ++i)
+		{
+			if (p->reg[i] != before[i])
+			{
+				r->flags |= RETIRE_REG;
+				r->reg = i;
+				r->value = p->reg[i];
+				break;
+			}
+		}
+		memcpy(cosimRegs[n], p->reg, sizeof(p->reg));
+		++n;
+		if (p->pc != r->pc + 2 || p->pc == p->breakpoint)
+			break;
+	}
+	return n;
+}
+
+/* An RTL write of the value a register already held is no change */
+static int RetireEqual(const NANO_RETIRE* sim, const NANO_RETIRE* rtl, const NANO_REG* regs)
+{
+	if (sim->pc != rtl->pc)
+		return 0;
+	if ((sim->flags & RETIRE_MEM) != (rtl->flags & RETIRE_MEM))
+		return 0;
+	if ((sim->flags & RETIRE_MEM) && (sim->addr != rtl->addr || sim->data != rtl->data))
+		return 0;
+	if (sim->flags & RETIRE_REG)
+		return (rtl->flags & RETIRE_REG) && sim->reg == rtl->reg && sim->value == rtl->value;
+	if (rtl->flags & RETIRE_REG)
+		return rtl->reg >= 0 && rtl->reg < 16 && regs[rtl->reg] == rtl->value;
+	return 1;
+}
+
+/*
+ *  ===== NanoCosimRun =====
+ *      Run up to count instructions on both sides, comparing a basic
+ *  block at a time.  Stops at the first mismatch (c->diverged) or at the
+ *  breakpoint.  Returns the number of instructions executed.
+ */
+long NanoCosimRun(NANO_COSIM* c, NANO_CPU* p, long count)
+{
+	NANO_BUS_TRACE saved = memTrace;
+	long done = 0;
+
+	MemSetTrace(CosimTrace);
+	while (done < count && !c->diverged)
+	{
+		int max = (count - done < COSIM_BLOCK) ? (int) (count - done) : COSIM_BLOCK;
+		int n = CosimStepBlock(c, p, max);
+		int m = c->rtl->run(c->rtl->ctx, c->rtlOut, n);
+		int i;
+
+		for (i = 0; i < n && i < m; ++i)
+		{
+			if (!RetireEqual(&c->sim[i], &c->rtlOut[i], cosimRegs[i]))
+				break;
+		}
+		if (i < n || m != n)
+		{
+			c->diverged = 1;
+			c->simCount = n;
+			c->rtlCount = m;
+			c->where = i;
+		}
+		else
+		{
+			c->retired += n;
+			++c->blocks;
+		}
+		done += n;
+		if (p->pc == p->breakpoint)
+			break;
+	}
+	MemSetTrace(saved);
+	return done;
+}
+
+static void ReportRetire(FILE* fp, const char* side, const NANO_RETIRE* r)
+{
+	fprintf(fp, "  %-4s pc " NANO_SZADDR, side, r->pc);
+	if (r->flags & RETIRE_REG)
+		fprintf(fp, "  %s=%04lx", szRegName[r->reg & 15], (unsigned long) r->value);
+	if (r->flags & RETIRE_MEM)
+		fprintf(fp, "  [" NANO_SZADDR "]%s=%04x", r->addr, (r->flags & RETIRE_BYTE) ? ".b" : "", r->data);
+	fprintf(fp, "\n");
+}
+
+/*
+ *  ===== NanoCosimReport =====
+ *      Print the first mismatch with the disassembly of the instruction.
+ */
+void NanoCosimReport(const NANO_COSIM* c, const NANO_CPU* p, FILE* fp)
+{
+	char szDisAsm[40];
+	const NANO_RETIRE* sim;
+
+	if (!c->diverged)
+	{
+		fprintf(fp, "cosim: ok, %lu instructions in %lu blocks\n",
+			(unsigned long) c->retired, c->blocks);
+		return;
+	}
+	if (c->where == c->simCount)
+	{
+		/* everything the RTL retired matched, but it stopped early or ran on */
+		sim = &c->sim[c->simCount - 1];
+		fprintf(fp, "cosim: rtl retired %d instructions of a %d instruction block ending at pc " NANO_SZADDR "\n",
+			c->rtlCount, c->simCount, sim->pc);
+		return;
+	}
+	sim = &c->sim[c->where];
+	NanoGetCore(p->bits)->DisAsm(szDisAsm, sizeof(szDisAsm), sim->pc, sim->opc);
+	fprintf(fp, "cosim: mismatch at instruction %lu, pc " NANO_SZADDR ": %04x  %s\n",
+		(unsigned long) (c->retired + c->where), sim->pc, sim->opc, szDisAsm);
+	ReportRetire(fp, "sim", sim);
+	if (c->where < c->rtlCount)
+		ReportRetire(fp, "rtl", &c->rtlOut[c->where]);
+	else
+		fprintf(fp, "  rtl  (not retired)\n");
+}
@@ -0,0 +1,88 @@
+/* nanocosim.h */
+
+#ifndef __NANOCOSIM_H__
+#define __NANOCOSIM_H__
+
+#include <stdio.h>
+#include "NanoCpu.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *  Lockstep co-simulation against an RTL model of the Nano CPU.
+ *
+ *  The model is a shared object (typically a thin C wrapper around a
+ *  Verilator build of the RTL) exporting NANO_RTL_ENTRY.  It is loaded
+ *  with the simulator's memory image and reset pc, then both sides retire
+ *  the same instructions: the interpreter (NanoSimInst) steps one basic
+ *  block, recording the pc, register write and memory write of every
+ *  instruction, and the model is asked to retire the same block in one
+ *  call so the RTL runs uninterrupted.  The two retire lists are then
+ *  compared.  Prefixes retire as separate instructions, as in hardware.
+ *
+ *  The model owns its memory and devices, so only stores to memory pages
+ *  are compared; the simulator's bus trace hook is used to see them.
+ */
+
+#define NANO_RTL_VERSION	1
+#define NANO_RTL_ENTRY		"NanoRtlInit"
+
+#define COSIM_BLOCK			64		/* most instructions per block */
+
+#define RETIRE_REG			0x0001	/* reg & value valid */
+#define RETIRE_MEM			0x0002	/* addr & data valid */
+#define RETIRE_BYTE			0x0004	/* with RETIRE_MEM: byte store */
+
+typedef struct
+{
+	NANO_ADDR pc;			/* address of the retired instruction */
+	NANO_INST opc;
+	int flags;				/* RETIRE_xxx */
+	int reg;				/* register written */
+	NANO_REG value;
+	NANO_ADDR addr;			/* memory written */
+	NANO_SHORT data;
+} NANO_RETIRE;
+
+typedef struct nano_rtl
+{
+	int version;			/* NANO_RTL_VERSION */
+	void* ctx;
+	void (*load)(void* ctx, const NANO_SHORT* image, int words);
+	void (*reset)(void* ctx, NANO_ADDR pc);
+	/* retire up to max instructions, stopping after a change of flow */
+	int (*run)(void* ctx, NANO_RETIRE* out, int max);
+	void (*close)(void* ctx);
+} NANO_RTL;
+
+typedef const NANO_RTL* (*NANO_RTL_INIT)(int bits);
+
+typedef struct
+{
+	void* lib;
+	const NANO_RTL* rtl;
+
+	NANO_TIME retired;		/* instructions compared */
+	unsigned long blocks;	/* blocks compared */
+
+	int diverged;			/* non-zero after a mismatch */
+	int simCount;			/* instructions in the mismatching block */
+	int rtlCount;
+	int where;				/* index of first mismatch in the block */
+	NANO_RETIRE sim[COSIM_BLOCK];
+	NANO_RETIRE rtlOut[COSIM_BLOCK];
+} NANO_COSIM;
+
+int NanoCosimInit(NANO_COSIM* c, const char* path, const NANO_CPU* p);
+void NanoCosimFree(NANO_COSIM* c);
+long NanoCosimRun(NANO_COSIM* c, NANO_CPU* p, long count);
+void NanoCosimReport(const NANO_COSIM* c, const NANO_CPU* p, FILE* fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOCOSIM_H__ */
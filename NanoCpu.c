@@ -7,12 +7,12 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <memory.h>
-#include "NanoCpu.h"
+#include "NanoMem.h"
+#include "NanoSched.h"
+#include "NanoVcd.h"
 
 #define BIT8            0x0100
 
-#define SIGN(w)         ((w) & NANO_MSB)
-
 #define NO_PREFIX       0
 
 #define NANO_PREFIX(p)  (p->prefix != NO_PREFIX)
@@ -20,6 +20,10 @@
 
 #define SHIFT_MASK      0x001f
 
+/* Extra cycles for multi-cycle ALU operations */
+#define MUL_CYCLES      2
+#define DIV_CYCLES(bits) (bits)     /* one quotient bit per cycle */
+
 /* eval 0-extended word offset prefix immediate */
 #define PREFIX_IMM_WORD(p, opc) \
     (((p)->prefix << 5) | OPC_OFF4(opc))
@@ -30,58 +34,6 @@
 
 #define WRITE_REG(p,dst,x)  { (p)->reg[dst] = (x); }
 
-/* Fetch byte at addr. */
-NANO_WORD NanoLoadByte(NANO_CPU* p, NANO_ADDR addr)
-{
-    NANO_SHORT data;
-    int cycles = MemReadWord(addr & ~1, &data);
-	if ((addr & 1) == 0)
-		data = data << 8;
-	// Sign extend into lower 8 bits
-	data = (signed short)data >> 8;
-    p->cycles += cycles;
-    return data;
-}
-
-/* Fetch word at addr. */
-NANO_WORD NanoLoadWord(NANO_CPU* p, NANO_ADDR addr)
-{
-    NANO_SHORT data;
-    int cycles = MemReadWord(addr, &data);
-    p->cycles += cycles;
-    return data;
-}
-
-/* Fetch long at addr. */
-NANO_LONG NanoLoadLong(NANO_CPU* p, NANO_ADDR addr)
-{
-    NANO_LONG data;
-    int cycles = MemReadLong(addr, &data);
-    p->cycles += cycles;
-    return data;
-}
-
-/* Store byte at addr. */
-void NanoStoreByte(NANO_CPU* p, NANO_ADDR addr, NANO_SHORT data)
-{
-    int cycles = MemWriteByte(addr, data);
-    p->cycles += cycles;
-}
-
-/* Store word at addr. */
-void NanoStoreWord(NANO_CPU* p, NANO_ADDR addr, NANO_SHORT data)
-{
-    int cycles = MemWriteWord(addr, data);
-    p->cycles += cycles;
-}
-
-/* Store long at addr. */
-void NanoStoreLong(NANO_CPU* p, NANO_ADDR addr, NANO_LONG data)
-{
-    int cycles = MemWriteLong(addr, data);
-    p->cycles += cycles;
-}
-
 /* Report illegal opcode. */
 void NanoIllegalOpcode(NANO_CPU* p)
 {
@@ -90,106 +42,28 @@ void NanoIllegalOpcode(NANO_CPU* p)
 /* Return processor state following reset.
  *
  * Args
- *  trace   - initial trace flags
+ *  bits    - word width of core (16 or 32)
  */
-void NanoReset(NANO_CPU* p)
+void NanoResetCore(NANO_CPU* p, int bits)
 {
     memset(p, 0, sizeof(NANO_CPU));
     p->prefix = NO_PREFIX;
+    p->bits = (bits == 32) ? 32 : 16;
 #if defined(_DEBUG)
 	p->ccr = NANO_N | NANO_C | NANO_V | NANO_Z;
 #endif
 }
 
+void NanoReset(NANO_CPU* p)
+{
+    NanoResetCore(p, 16);
+}
+
 /* Macro to compute the sum of a+b+carry and return carry out */
 #define ALU_ADDSUB(r, a, b, carry) \
     r = (a) + (b) + (carry); \
     carry = carry ? (r <= (a)) || (r <= (b)) : (r < (a)) || (r < (b));
 
-void NanoAluOp(NANO_CPU* p, NANO_ALU alu, int Rx, NANO_WORD a, NANO_WORD b)
-{
-    NANO_WORD result;
-    NANO_WORD cond;
-    NANO_WORD carry;
-
-    carry = (p->ccr & NANO_C) ? 1 : 0;
-
-    switch (alu)
-	{
-    case ALU_ADD:
-		carry = 0;
-    case ALU_ADC:   /* Add w/ Carry */
-        ALU_ADDSUB(result, a, b, carry);
-        WRITE_REG(p, Rx, result);
-        break;
-	case ALU_SUB:
-		carry = 0;
-    case ALU_SBC:   /* Subtract w/ Carry */
-        carry = carry ? 0 : 1;
-        b = ~b;
-        ALU_ADDSUB(result, a, b, carry);
-        carry = !carry;
-        WRITE_REG(p, Rx, result);
-        break;
-	case ALU_RSUB:
-		result = b - a;
-		WRITE_REG(p, Rx, result);
-		break;
-    case ALU_AND:   /* And */
-        result = a & b;
-        WRITE_REG(p, Rx, result);
-        break;
-    case ALU_OR:    /* Or */
-        result = a | b;
-        WRITE_REG(p, Rx, result);
-        break;
-    case ALU_XOR:   /* eXclusive Or */
-        result = a ^ b;
-        WRITE_REG(p, Rx, result);
-        break;
-#if 0
-    case ALU_SHIFT: /* SHIFT */
-        b = b & SHIFT_MASK;
-        for (result = a; b != 0; --b)
-        {
-            carry = (result & 1) ? 1 : 0;
-            if (b & NANO_SHIFT_LEFT)
-                result = ((NANO_SWORD) result << 1);
-            else
-                result = ((NANO_WORD) result >> 1);
-        }
-        WRITE_REG(p, Rx, result);
-        break;
-    case ALU_LSH:   /* Logical Shift */
-        b = b & SHIFT_MASK;
-        for (result = a; b != 0; --b)
-        {
-            carry = (result & 1) ? 1 : 0;
-            if (b & NANO_SHIFT_LEFT)
-                result = ((NANO_WORD) result << 1);
-            else
-                result = ((NANO_WORD) result >> 1);
-        }
-        WRITE_REG(p, Rx, result);
-        break;
-#endif
-    }
-    /* Update Condition Codes based on result, a & b */
-    cond = (result & NANO_MSB) ? NANO_N : 0;
-
-    /* overflow if the sign of the result is different from the signs of both operands */
-    if (SIGN(a ^ result) && SIGN(b ^ result))
-        cond |= NANO_V;
-
-    if (result == 0)
-        cond |= NANO_Z;
-
-    if (carry)
-        cond |= NANO_C;
-	// Update condition codes
-	p->ccr = cond;
-}
-
 /* Local function to find length of instruction */
 static int InstLength(NANO_ADDR addr)
 {
@@ -199,7 +73,7 @@ static int InstLength(NANO_ADDR addr)
     do
     {
         NANO_INST opc;
-        MemReadWord(addr, &opc);    /* Fetch opcode */
+        MemFetchWord(addr, &opc);   /* Fetch opcode */
         addr += 2;
         type = GET_OPC(opc);
         length += 2;
@@ -264,12 +138,6 @@ int NanoTestCond(NANO_CPU* p, int cond)
     return br;
 }
 
-
-/*
- *  ===== NanoSimInst =====
- *      Simulate one or more CPU instructions. Note: prefixes are treated as
- *  separate instructions to mimic the behaviour of the hardware.
- */
 typedef enum
 {
     NANO_STOP, NANO_RUN
@@ -277,162 +145,58 @@ typedef enum
 
 NANO_CPU_STATE cpuState = NANO_RUN;
 
-int NanoSimInst(NANO_CPU* p, NANO_STEP step)
-{
-    NANO_ADDR breakpt;
-    int count = 1000000;
-    switch (step)
-    {
-    case NANO_STEP_OVER:
-        breakpt = p->pc + InstLength(p->pc);
-        break;
-    case NANO_STEP_OUT:
-        breakpt = p->reg[15];
-        break;
-    default:
-        breakpt = 0;
-    }
-    cpuState = NANO_RUN;
-    while (cpuState == NANO_RUN) {
-        /* Fetch 16-bit instruction opcode */
-        NANO_INST opc;
-        NANO_ADDR addr;
-        NANO_WORD data;
-        int Rx,Ry,Rz;
-
-        int cycles = MemReadWord(p->pc, &opc);
-        p->cycles += cycles;
-
-        p->pc += 2;
-
-		/* Decode (register) fields */
-		Rx = OPC_RX(opc);
-		Ry = OPC_RY(opc);
-		Rz = OPC_RZ(opc);
-
-        switch (GET_OPC(opc))
-		{
-        case OPC_ADD_IMM:
-			p->ccr &= ~NANO_C; // Clear CARRY
-            data = ((p)->prefix << 4) | OPC_IMM4(opc);
-
-            NanoAluOp(p, ALU_ADC, Rx, p->reg[Ry], data);
-            p->prefix = NO_PREFIX;
-            break;
-        case OPC_SUB_IMM:
-			p->ccr &= ~NANO_C; // Clear CARRY
-            data = ((p)->prefix << 4) | OPC_IMM4(opc);
-
-            NanoAluOp(p, ALU_ADC, Rx, p->reg[Ry], data);
-            p->prefix = NO_PREFIX;
-            break;
-		case OPC_ADC_IMM:
-			data = ((p)->prefix << 4) | OPC_IMM4(opc);
-
-			NanoAluOp(p, ALU_ADC, Rx, p->reg[Ry], data);
-			p->prefix = NO_PREFIX;
-			break;
-		case OPC_SBC_IMM:
-			data = ((p)->prefix << 4) | OPC_IMM4(opc);
-
-			NanoAluOp(p, ALU_SBC, Rx, p->reg[Ry], data);
-			p->prefix = NO_PREFIX;
-			break;
-		case OPC_RSUB_IMM:
-			p->ccr &= ~NANO_C; // Clear CARRY
-			data = ((p)->prefix << 4) | OPC_IMM4(opc);
-
-			NanoAluOp(p, ALU_RSUB, Rx, p->reg[Ry], data);
-			p->prefix = NO_PREFIX;
-			break;
-		case OPC_AND_IMM:
-			p->ccr &= ~NANO_C; // Clear CARRY
-            data = ((p)->prefix << 4) | OPC_IMM4(opc);
+/*
+ *  ===== 16-bit core =====
+ */
+#define CORE_BITS       16
+#define CORE_WORD       uint16_t
+#define CORE_SWORD      int16_t
+#define CORE_MSB        0x8000
+#define CORE(name)      name##16
+#include "NanoCore.h"
+#undef CORE_BITS
+#undef CORE_WORD
+#undef CORE_SWORD
+#undef CORE_MSB
+#undef CORE
 
-            NanoAluOp(p, ALU_AND, Rx, p->reg[Ry], data);
-            p->prefix = NO_PREFIX;
-            break;
-        case OPC_OR_IMM:
-			p->ccr &= ~NANO_C; // Clear CARRY
-            data = ((p)->prefix << 4) | OPC_IMM4(opc);
+/*
+ *  ===== 32-bit core =====
+ */
+#define CORE_BITS       32
+#define CORE_WORD       uint32_t
+#define CORE_SWORD      int32_t
+#define CORE_MSB        0x80000000UL
+#define CORE(name)      name##32
+#include "NanoCore.h"
+#undef CORE_BITS
+#undef CORE_WORD
+#undef CORE_SWORD
+#undef CORE_MSB
+#undef CORE
+
+static const NANO_CORE nanoCore16 =
+{
+    16, "%04x", NanoSimInst16, NanoRunInst16, NanoDisAsm16
+};
 
-            NanoAluOp(p, ALU_OR, Rx, p->reg[Ry], data);
-            p->prefix = NO_PREFIX;
-            break;
-        case OPC_XOR_IMM:
-			p->ccr &= ~NANO_C; // Clear CARRY
-            data = ((p)->prefix << 4) | OPC_IMM4(opc);
+static const NANO_CORE nanoCore32 =
+{
+    32, "%08x", NanoSimInst32, NanoRunInst32, NanoDisAsm32
+};
 
-            NanoAluOp(p, ALU_XOR, Rx, p->reg[Ry], data);
-            p->prefix = NO_PREFIX;
-            break;
-        case OPC_ALU_REG:
-            NanoAluOp(p, Rz, Rx, p->reg[Rx], p->reg[Ry]);
-            p->prefix = NO_PREFIX;
-            break;
-		case OPC_LB_OFF:
-			addr = p->reg[Ry] + OPC_OFF4(opc)*2;
-			data = NanoLoadByte(p, addr);
-			WRITE_REG(p, Rx, data);
-			break;
-		case OPC_SB_OFF:
-			addr = p->reg[Ry] + OPC_OFF4(opc);
-			data = p->reg[Rx];
-			NanoStoreByte(p, addr, data);
-			break;
-		case OPC_MOV_IMM:
-			p->ccr &= ~NANO_C; // Clear CARRY
-			data = ((p)->prefix << 8) | OPC_IMM8(opc);
-			WRITE_REG(p, Rx, data);
-			p->prefix = NO_PREFIX;
-			break;
-		case OPC_LW_OFF:
-			addr = p->reg[Ry] + OPC_OFF4(opc);
-			if (addr & 1)
-			{
-				// Load Byte
-				data = NanoLoadByte(p, addr);
-			}
-			else
-			{
-				data = NanoLoadWord(p, addr);
-			}
-			WRITE_REG(p, Rx, data);
-			break;
-		case OPC_SW_OFF:
-			addr = p->reg[Ry] + OPC_OFF4(opc)*2;
-			data = p->reg[Rx];
-			if (addr & 1)
-			{
-				NanoStoreByte(p, addr, data);
-			}
-			else
-			{
-				NanoStoreWord(p, addr, data);
-			}
-			break;
-        case OPC_BRANCH:
-		{
-            int br = NanoTestCond(p, OPC_COND(opc));
-            if (br) {
-                p->pc += 2*SIGN_EXT(OPC_IMM8(opc), 0x80);
-                p->cycles += 2;
-            }
-            break;
-        }
-        case OPC_IMM:
-            p->prefix = (p->prefix << 12) | OPC_IMM12(opc);
-            break;
-        default:
-            NanoIllegalOpcode(p);
-            break;
-        }
+/* Select core for word width (16 or 32) */
+const NANO_CORE* NanoGetCore(int bits)
+{
+    return (bits == 32) ? &nanoCore32 : &nanoCore16;
+}
 
-        /* Stop on breakpoint(s) or single step */
-        if (p->pc == breakpt || p->pc == p->breakpoint ||
-            step == NANO_STEP_INTO || --count == 0)
-            break;
-    }
-    return 0;
+int NanoSimInst(NANO_CPU* p, NANO_STEP step)
+{
+    return (p->bits == 32) ? NanoSimInst32(p, step) : NanoSimInst16(p, step);
 }
 
+long NanoRunInst(NANO_CPU* p, long count)
+{
+    return (p->bits == 32) ? NanoRunInst32(p, count) : NanoRunInst16(p, count);
+}
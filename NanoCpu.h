@@ -31,14 +31,14 @@ typedef enum
 	ALU_OR    =  6,		/* inclusive OR */
 	ALU_XOR   =  7,		/* eXclusive OR */
 
-	ALU_MUL   =  8,		/* MULtiply */
-	ALU_DIV   =  8,		/* reserved for DIV */
+	ALU_MUL   =  8,		/* MULtiply (low word, C = high word != 0) */
+	ALU_DIV   =  9,		/* unsigned DIVide (V = divide by zero) */
 	ALU_ASR   =  10,	/* Arithmetic Shift Right */
 	ALU_LSR   =  11,	/* Logical Shift Right */
 	ALU_CX    =  12,	/* reserved (CX) */
 	ALU_DX    =  13,	/* reserved (DX) */
 	LINK      =  14,	/* LINK Rd = PC */
-	LD_IMM    =  15,	/* LD IMM (upper 16-bits) */
+	LD_IMM    =  15,	/* LD IMM (upper half of Rd = Rs) */
 
 } NANO_ALU;
 
@@ -150,23 +150,16 @@ typedef unsigned short NANO_SHORT;
 typedef unsigned long  NANO_LONG;
 typedef unsigned long  NANO_TIME;
 
-#ifdef _NANO32
-	typedef signed   long NANO_SWORD;
-	typedef unsigned long NANO_WORD;
-	typedef unsigned long NANO_ADDR;
-	typedef __int64       NANO_DWORD;
-	#define NANO_BITS	32
-	#define NANO_MSB    0x80000000L
-	#define NANO_SZADDR "%08x"
-#else
-	typedef signed   short NANO_SWORD;
-	typedef unsigned short NANO_WORD;
-	typedef unsigned short NANO_ADDR;
-	typedef long           NANO_DWORD;
-	#define NANO_SZADDR "%04x"
-	#define NANO_BITS	16
-	#define NANO_MSB    0x8000
-#endif
+/*
+ *  Both 16 and 32-bit cores are built into every binary (see NanoCore.h)
+ *  and one is selected when the CPU is reset.  Registers and bus addresses
+ *  are wide enough for either; memory is always 16-bit words.
+ */
+typedef unsigned short NANO_WORD;		/* 16-bit memory/bus word */
+typedef uint32_t       NANO_REG;		/* register (zero extended) */
+typedef uint32_t       NANO_ADDR;		/* bus address */
+
+#define NANO_SZADDR "%04x"
 
 #define NANO_N		0x0001
 #define NANO_C		0x0002
@@ -175,14 +168,15 @@ typedef unsigned long  NANO_TIME;
 
 typedef struct
 {
-	NANO_WORD reg[16];
+	NANO_REG reg[16];
 	NANO_ADDR pc;
-	NANO_WORD temp;
-	NANO_WORD prefix;
+	NANO_REG temp;
+	NANO_REG prefix;
 	NANO_TIME cycles;
 	NANO_WORD ccr;
 
 	NANO_ADDR breakpoint;
+	int bits;					/* word width of core: 16 or 32 */
 } NANO_CPU;
 
 typedef enum
@@ -191,6 +185,7 @@ typedef enum
 } NANO_STEP;
 
 void NanoReset(NANO_CPU* pCpu);
+void NanoResetCore(NANO_CPU* pCpu, int bits);
 
 extern NANO_WORD led_out;
 extern NANO_WORD sw_inp;
@@ -202,12 +197,38 @@ int MemWriteWord(NANO_ADDR addr, NANO_SHORT data);
 int MemWriteLong(NANO_ADDR addr, NANO_LONG data);
 void MemCopyBytes(NANO_ADDR addr, void* buf, int length);
 
-// Implemented by Simulator
-void OutWriteWord(NANO_ADDR addr, NANO_SHORT data);
-NANO_SHORT InpReadWord(NANO_ADDR addr);
+// Bulk access to big-endian byte blocks
+void MemWriteBlock(NANO_ADDR addr, const void* buf, NANO_ADDR length);
+void MemReadBlock(NANO_ADDR addr, void* buf, NANO_ADDR length);
+void MemFillBlock(NANO_ADDR addr, NANO_SHORT word, NANO_ADDR length);
+
+#define NANO_MEM_WORDS	32768		// 32K x 16 (64K Bytes) of Memory
+
+// Memory images (NANO_MEM_WORDS words) for snapshots & verification
+void MemSaveImage(NANO_SHORT* image);
+void MemLoadImage(const NANO_SHORT* image);
+unsigned long MemChecksum(void);
 
 int NanoSimInst(NANO_CPU* p, NANO_STEP step);
+long NanoRunInst(NANO_CPU* p, long count);
 int NanoDisAsm(char* line, size_t len, NANO_ADDR addr, NANO_INST opc);
+int NanoDisAsm16(char* line, size_t len, NANO_ADDR addr, NANO_INST opc);
+int NanoDisAsm32(char* line, size_t len, NANO_ADDR addr, NANO_INST opc);
+
+/*
+ *  Core for one word width.  Select once (e.g. at load time) with
+ *  NanoGetCore() and call through it to avoid per-call width checks.
+ */
+typedef struct
+{
+	int bits;
+	const char* szWord;			/* printf format for a register/address */
+	int (*SimInst)(NANO_CPU* p, NANO_STEP step);
+	long (*RunInst)(NANO_CPU* p, long count);
+	int (*DisAsm)(char* line, size_t len, NANO_ADDR addr, NANO_INST opc);
+} NANO_CORE;
+
+const NANO_CORE* NanoGetCore(int bits);
 
 extern const char szRegName[16][4];
 
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NanoDisCache.h"
+#include "NanoMem.h"
+
+static DIS_ENTRY* disCache = NULL;
+static const NANO_CORE* disCore = NULL;
+static DIS_ENTRY disScratch;			/* words outside RAM pages */
+
+int DisCacheInit(const NANO_CORE* core)
+{
+	DisCacheFree();
+	disCache = (DIS_ENTRY*) calloc(MEM_SIZE / 2, sizeof(DIS_ENTRY));
+	if (disCache == NULL)
+		return -1;
+	disCore = core;
+	return 0;
+}
+
+void DisCacheFree(void)
+{
+	free(disCache);
+	disCache = NULL;
+}
+
+static void DisFormat(DIS_ENTRY* entry, NANO_ADDR addr, NANO_SHORT opc)
+{
+	if (!entry->valid)
+		sprintf(entry->addr, "%04x", addr);
+	sprintf(entry->data, "%04x", opc);
+	disCore->DisAsm(entry->text, DIS_TEXT_SIZE, addr, opc);
+	entry->opc = opc;
+	entry->valid = 1;
+}
+
+/*
+ *  Bring the entry for even addr of a RAM page up to date; returns
+ *  non-zero if it had to be formatted.  The generation is read before the
+ *  word so a store racing with us (from an engine thread) leaves the
+ *  entry stale, never wrong.  The word is read from the page directly so
+ *  the view does not show up in bus traces or the heatmap.
+ */
+static int DisRefresh(DIS_ENTRY* entry, NANO_ADDR addr)
+{
+	unsigned long gen = MemPageGen(addr);
+	NANO_SHORT opc;
+
+	if (entry->valid && entry->gen == gen)
+		return 0;
+	opc = memPage[MEM_PAGE_NUM(addr)].ram[MEM_PAGE_IDX(addr)];
+	entry->gen = gen;
+	if (entry->valid && entry->opc == opc)
+		return 0;
+	DisFormat(entry, addr, opc);
+	return 1;
+}
+
+/*
+ *  ===== DisCacheGet =====
+ *      Formatted entry for the word at addr.  Device and far words are
+ *  shown as DIS_NO_DATA without being read: a device read runs its
+ *  handler (popping UART input, say) on this thread while the engine
+ *  runs, and a far read refills the MMU's TLB behind its back.
+ */
+const DIS_ENTRY* DisCacheGet(NANO_ADDR addr)
+{
+	addr &= ~1;
+	if (addr >= MEM_SIZE || memPage[MEM_PAGE_NUM(addr)].ram == NULL)
+	{
+		sprintf(disScratch.addr, "%04x", addr);
+		strcpy(disScratch.data, DIS_NO_DATA);
+		disScratch.text[0] = '\0';
+		disScratch.valid = 0;
+		return &disScratch;
+	}
+	if (disCache == NULL)
+	{
+		disScratch.valid = 0;
+		DisFormat(&disScratch, addr, memPage[MEM_PAGE_NUM(addr)].ram[MEM_PAGE_IDX(addr)]);
+		return &disScratch;
+	}
+	DisRefresh(&disCache[addr >> 1], addr);
+	return &disCache[addr >> 1];
+}
+
+/*
+ *  ===== DisCacheUpdate =====
+ *      Bring the entry for addr up to date without drawing it.  Returns
+ *  non-zero if its text changed, i.e. a view showing it must redraw it.
+ */
+int DisCacheUpdate(NANO_ADDR addr)
+{
+	addr &= ~1;
+	if (disCache == NULL || addr >= MEM_SIZE || memPage[MEM_PAGE_NUM(addr)].ram == NULL)
+		return 0;
+	return DisRefresh(&disCache[addr >> 1], addr);
+}
+
+/*
+ *  ===== DisCachePrefetch =====
+ *      Format up to max stale RAM words in [addr, end).  Returns how many
+ *  were formatted, so a caller can stop once a pass finds none.
+ */
+int DisCachePrefetch(NANO_ADDR addr, NANO_ADDR end, int max)
+{
+	int done = 0;
+	if (disCache == NULL)
+		return 0;
+	if (end > MEM_SIZE)
+		end = MEM_SIZE;
+	for (addr &= ~1; addr < end && done < max; addr += 2)
+	{
+		if (memPage[MEM_PAGE_NUM(addr)].ram == NULL)
+			continue;
+		done += DisRefresh(&disCache[addr >> 1], addr);
+	}
+	return done;
+}
@@ -0,0 +1,53 @@
+/* nanodiscache.h */
+
+#ifndef __NANODISCACHE_H__
+#define __NANODISCACHE_H__
+
+#include "NanoCpu.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *  Disassembly cache for memory views
+ *
+ *  Holds the formatted address, data and disassembly text of every word
+ *  of the page table, stamped with the page's write generation.  A lookup
+ *  whose page has not been written since costs a compare; after a write
+ *  only the words whose value actually changed are formatted again.
+ *  Device and far words are never read, since a read could have side
+ *  effects or race with the engine; they show DIS_NO_DATA.
+ *
+ *  The cache belongs to the front end thread.  DisCacheUpdate tells a
+ *  view which visible rows really changed, so it redraws only those.
+ *  DisCachePrefetch formats a bounded number of stale words around the
+ *  viewport from an idle or timer handler so that scrolling finds them
+ *  ready.
+ */
+
+#define DIS_TEXT_SIZE	28
+#define DIS_NO_DATA		"----"			/* data shown for words not read */
+
+typedef struct
+{
+	unsigned long gen;			/* page generation when formatted */
+	NANO_SHORT opc;
+	char valid;
+	char addr[11];
+	char data[5];
+	char text[DIS_TEXT_SIZE];
+} DIS_ENTRY;
+
+int DisCacheInit(const NANO_CORE* core);
+void DisCacheFree(void);
+const DIS_ENTRY* DisCacheGet(NANO_ADDR addr);
+int DisCacheUpdate(NANO_ADDR addr);
+int DisCachePrefetch(NANO_ADDR addr, NANO_ADDR end, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANODISCACHE_H__ */
@@ -9,8 +9,8 @@
 char szAlu[16][5] =
 {
 /*   0/8     1/9     2/A     3/B     4/C     5/D     6/E     7/F  */
-    "add",  "sub",  "adc",  "sbc ", "rsub", "and",  "or ",  "xor",
-    "mul",  "div",  "asr",  "lsr ", "aluc", "alud", "alue", "aluf"
+    "add",  "sub",  "adc",  "sbc",  "rsub", "and",  "or",   "xor",
+    "mul",  "div",  "asr",  "lsr",  "aluc", "alud", "link", "ldhi"
 };
 
 /*
@@ -38,11 +38,13 @@ const char szRegName[16][4] =
 #endif
 
 /*
- *  ===== NanoDisAsm =====
+ *  ===== DisAsm =====
  *      Disassemble one instruction.  Note: prefixes are treated as
  *  separate instructions to mimic the behaviour of the hardware.
+ *  Branch targets wrap with mask and print with szBranch.
  */
-int NanoDisAsm(char* line, size_t len, NANO_ADDR addr, NANO_INST opc)
+static int DisAsm(char* line, size_t len, NANO_ADDR addr, NANO_INST opc,
+	NANO_ADDR mask, const char* szBranch)
 {
     int length;
 	int Rx, Ry;
@@ -84,10 +86,13 @@ int NanoDisAsm(char* line, size_t len, NANO_ADDR addr, NANO_INST opc)
 		length = SNPRINTF(line, len, "sb  %s,%u[%s]", szRegName[Rx], OPC_OFF4(opc), szRegName[Ry]);
 		break;
 	case OPC_ALU_REG:
-		length = SNPRINTF(line, len, "%s  %s,%s", szAlu[OPC_RZ(opc)], szRegName[Rx], szRegName[Ry]);
+		if (OPC_RZ(opc) == LINK)
+			length = SNPRINTF(line, len, "%-4s %s", szAlu[LINK], szRegName[Rx]);
+		else
+			length = SNPRINTF(line, len, "%-4s %s,%s", szAlu[OPC_RZ(opc)], szRegName[Rx], szRegName[Ry]);
         break;
     case OPC_BRANCH:
-		length = SNPRINTF(line, len, "%-4s $" NANO_SZADDR, szBra[Rx], addr + 2 * SIGN_EXT(opc, 128) + 2);
+		length = SNPRINTF(line, len, szBranch, szBra[Rx], (addr + 2 * SIGN_EXT(opc, 128) + 2) & mask);
         break;
 	case OPC_MOV_IMM:
 		length = SNPRINTF(line, len, "mov %s,#%-3u", szRegName[Rx], OPC_IMM8(opc));
@@ -107,3 +112,18 @@ int NanoDisAsm(char* line, size_t len, NANO_ADDR addr, NANO_INST opc)
     }
     return length;
 }
+
+int NanoDisAsm16(char* line, size_t len, NANO_ADDR addr, NANO_INST opc)
+{
+	return DisAsm(line, len, addr, opc, 0xFFFF, "%-4s $%04x");
+}
+
+int NanoDisAsm32(char* line, size_t len, NANO_ADDR addr, NANO_INST opc)
+{
+	return DisAsm(line, len, addr, opc, 0xFFFFFFFF, "%-4s $%08x");
+}
+
+int NanoDisAsm(char* line, size_t len, NANO_ADDR addr, NANO_INST opc)
+{
+	return NanoDisAsm16(line, len, addr, opc);
+}
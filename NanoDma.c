@@ -0,0 +1,126 @@
+#include "NanoDma.h"
+
+#define DMA_REGS		8
+#define DMA_REG(a)		(((a) - DMA_BASE) >> 1)
+
+static NANO_SHORT dmaReg[DMA_REGS];
+
+#define DMA_ADDR(lo)	(((NANO_ADDR) dmaReg[DMA_REG(lo) + 1] << 16) | dmaReg[DMA_REG(lo)])
+
+/*
+ *  Blocks are read as big-endian words while guest bytes are little
+ *  endian (even address = low byte), so guest byte i of a block read from
+ *  an even address is at block offset i ^ 1.
+ */
+#define GUEST_BYTE(buf, i)	((buf)[(i) ^ 1])
+
+/*
+ *  ===== DmaTransfer =====
+ *      Perform the programmed transfer.  Returns the stall cycles.
+ */
+static int DmaTransfer(void)
+{
+	unsigned char buf[MEM_PAGE_SIZE + 2];
+	unsigned char out[MEM_PAGE_SIZE];
+	NANO_ADDR src = DMA_ADDR(DMA_SRC);
+	NANO_ADDR dst = DMA_ADDR(DMA_DST);
+	NANO_ADDR len = dmaReg[DMA_REG(DMA_LEN)];
+	NANO_SHORT ctrl = dmaReg[DMA_REG(DMA_CTRL)];
+	long units;
+
+	if (ctrl & DMA_DST_FIXED)
+	{
+		/* byte stream to a device register */
+		NANO_ADDR done;
+		units = len;
+		for (done = 0; done < len; )
+		{
+			NANO_ADDR base = (src + done) & ~1;
+			NANO_ADDR skip = (src + done) & 1;
+			NANO_ADDR count = len - done;
+			NANO_ADDR i;
+			if (count > MEM_PAGE_SIZE)
+				count = MEM_PAGE_SIZE;
+			MemReadBlock(base, buf, (skip + count + 1) & ~1);
+			for (i = 0; i < count; ++i)
+				out[i] = GUEST_BYTE(buf, skip + i);
+			MemWriteFifo(dst, out, count);
+			done += count;
+		}
+	}
+	else if (((src | dst | len) & 1) == 0)
+	{
+		/*
+		 * whole words: block copy.  Each block is read before it is
+		 * stored, so blocks no longer than dst - src give the same result
+		 * as the byte at a time copy of the unaligned path.
+		 */
+		NANO_ADDR done;
+		NANO_ADDR step = MEM_PAGE_SIZE;
+		if (dst > src && dst - src < step)
+			step = dst - src;
+		units = len >> 1;
+		for (done = 0; done < len; done += step)
+		{
+			NANO_ADDR count = len - done;
+			if (count > step)
+				count = step;
+			MemReadBlock(src + done, buf, count);
+			MemWriteBlock(dst + done, buf, count);
+		}
+	}
+	else
+	{
+		/* unaligned: gather guest bytes, store one at a time */
+		NANO_ADDR i;
+		units = (len + 1) >> 1;
+		for (i = 0; i < len; ++i)
+		{
+			NANO_SHORT word = 0;
+			MemReadWord((src + i) & ~1, &word);
+			MemWriteByte(dst + i, ((src + i) & 1) ? word >> 8 : word & 0xFF);
+		}
+	}
+	dmaReg[DMA_REG(DMA_STATUS)] |= DMA_DONE;
+	return DMA_SETUP_CYCLES + (int) (units * dmaReg[DMA_REG(DMA_COST)]);
+}
+
+static int DmaRead(void* ctx, NANO_ADDR addr, NANO_SHORT* data)
+{
+	int n = DMA_REG(addr & ~1);
+	*data = (n < DMA_REGS) ? dmaReg[n] : 0;
+	return 1;
+}
+
+static int DmaWrite(void* ctx, NANO_ADDR addr, NANO_SHORT data)
+{
+	int n = DMA_REG(addr & ~1);
+	if (n >= DMA_REGS)
+		return 1;
+	if (n == DMA_REG(DMA_STATUS))
+	{
+		dmaReg[n] &= ~data;
+		return 1;
+	}
+	dmaReg[n] = data;
+	if (n == DMA_REG(DMA_CTRL) && (data & DMA_START))
+	{
+		dmaReg[DMA_REG(DMA_STATUS)] &= ~DMA_DONE;
+		return DmaTransfer();
+	}
+	return 1;
+}
+
+static const NANO_DEVICE dmaDevice =
+{
+	"dma", DmaRead, DmaWrite, NULL
+};
+
+void DmaInit(void)
+{
+	int n;
+	for (n = 0; n < DMA_REGS; ++n)
+		dmaReg[n] = 0;
+	dmaReg[DMA_REG(DMA_COST)] = DMA_DEF_COST;
+	MemMapDevice(DMA_BASE, MEM_PAGE_SIZE, &dmaDevice);
+}
@@ -0,0 +1,53 @@
+/* nanodma.h */
+
+#ifndef __NANODMA_H__
+#define __NANODMA_H__
+
+#include "NanoMem.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *  DMA controller
+ *
+ *  Writing DMA_START to DMA_CTRL copies DMA_LEN bytes from DMA_SRC to
+ *  DMA_DST on the host and sets DMA_DONE in DMA_STATUS.  The transfer
+ *  completes before the store retires; the CPU is stalled for
+ *  DMA_SETUP_CYCLES plus DMA_COST cycles per word (per byte with
+ *  DMA_DST_FIXED).  With DMA_DST_FIXED every byte is stored to DMA_DST,
+ *  e.g. the UART data register, in page sized runs through MemWriteFifo.
+ *  The HI registers hold the upper 16 address bits for the 32-bit core.
+ *
+ *  Memory to memory copies behave as if each byte were read and stored in
+ *  turn from the lowest address up, whatever the alignment: a copy to a
+ *  higher overlapping address repeats the first DMA_DST - DMA_SRC bytes.
+ */
+
+#define DMA_BASE		0xFB00
+#define DMA_SRC			(DMA_BASE + 0x00)
+#define DMA_SRCHI		(DMA_BASE + 0x02)
+#define DMA_DST			(DMA_BASE + 0x04)
+#define DMA_DSTHI		(DMA_BASE + 0x06)
+#define DMA_LEN			(DMA_BASE + 0x08)	/* bytes */
+#define DMA_CTRL		(DMA_BASE + 0x0A)
+#define DMA_STATUS		(DMA_BASE + 0x0C)	/* write to clear */
+#define DMA_COST		(DMA_BASE + 0x0E)	/* cycles per unit */
+
+#define DMA_START		0x0001				/* CTRL: start transfer */
+#define DMA_DST_FIXED	0x0002				/* CTRL: store bytes to DST */
+
+#define DMA_DONE		0x0001				/* STATUS: transfer complete */
+
+#define DMA_SETUP_CYCLES	4
+#define DMA_DEF_COST		1
+
+void DmaInit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANODMA_H__ */
@@ -0,0 +1,229 @@
+#include <string.h>
+#include "NanoEngine.h"
+#include "NanoGpio.h"
+#include "NanoUart.h"
+#include "NanoAtomic.h"
+#include "NanoThread.h"
+#include "NanoPace.h"
+
+#define QUEUE_MASK		(ENGINE_QUEUE - 1)
+
+typedef struct
+{
+	ENGINE_CMD cmd;
+	unsigned long arg;
+} ENGINE_MSG;
+
+static ENGINE_MSG engQueue[ENGINE_QUEUE];
+static volatile unsigned engHead = 0;		/* next command posted by front end */
+static volatile unsigned engTail = 0;		/* next command taken by engine */
+
+/* Published state, guarded by engSeq (odd while being written) */
+static volatile unsigned engSeq = 0;
+static NANO_CPU engShared;
+static ENGINE_STATS engSharedStats;
+static volatile int engSharedRunning = 0;
+
+static const NANO_CORE* engCore = NULL;
+static NANO_CPU engCpu;
+static NANO_ADDR engBreak = ENGINE_NO_BREAK;
+static int engRunning = 0;
+static NANO_PACE engPace;					/* hz 0: not paced */
+static ENGINE_STATS engStats;
+static NANO_THREAD engThread;
+static int engStarted = 0;
+
+static void EnginePublish(void)
+{
+	unsigned seq = engSeq;
+	engSeq = seq + 1;
+	NANO_BARRIER();
+	engShared = engCpu;
+	engStats.us = NanoTimeUs();
+	engStats.hz = (engPace.hz != 0) ? engPace.hz : ENGINE_CLOCK_HZ;
+	engSharedStats = engStats;
+	engSharedRunning = engRunning;
+	NANO_STORE_RELEASE(engSeq, seq + 2);
+}
+
+/* Run up to count instructions, paced if asked, adding to the counters */
+static long EngineRun(long count)
+{
+	NANO_TIME start = engCpu.cycles;
+	long n;
+	if (engPace.hz != 0)
+		n = PaceRun(&engPace, engCore, &engCpu, count);
+	else
+		n = engCore->RunInst(&engCpu, count);
+	engStats.insts += n;
+	engStats.cycles += engCpu.cycles - start;
+	return n;
+}
+
+/* Returns non-zero for ENGINE_QUIT */
+static int EngineCommand(const ENGINE_MSG* msg)
+{
+	switch (msg->cmd)
+	{
+	case ENGINE_GO:
+		engRunning = 1;
+		if (engPace.hz != 0)
+			PaceStart(&engPace, &engCpu);
+		break;
+	case ENGINE_BREAK:
+		engRunning = 0;
+		break;
+	case ENGINE_STEP:
+		if (!engRunning)
+			engCore->SimInst(&engCpu, (NANO_STEP) msg->arg);
+		break;
+	case ENGINE_RESET:
+		NanoResetCore(&engCpu, engCore->bits);
+		engCpu.breakpoint = engBreak;
+		if (engPace.hz != 0)
+			PaceStart(&engPace, &engCpu);
+		break;
+	case ENGINE_BREAKPOINT:
+		engBreak = (NANO_ADDR) msg->arg;
+		engCpu.breakpoint = engBreak;
+		break;
+	case ENGINE_INPUT:
+		GpioSetInput((NANO_WORD) msg->arg);
+		break;
+	case ENGINE_HEAT:
+		MemSetHeat(msg->arg != 0);
+		break;
+	case ENGINE_PACE:
+		PaceInit(&engPace, msg->arg);
+		PaceStart(&engPace, &engCpu);
+		break;
+	case ENGINE_QUIT:
+		engRunning = 0;
+		return 1;
+	}
+	return 0;
+}
+
+static void EngineMain(void* arg)
+{
+	for (;;)
+	{
+		unsigned tail = engTail;
+		unsigned head = NANO_LOAD_ACQUIRE(engHead);
+		if (tail != head)
+		{
+			int quit = 0;
+			while (tail != head && !quit)
+			{
+				quit = EngineCommand(&engQueue[tail & QUEUE_MASK]);
+				++tail;
+			}
+			EnginePublish();
+			NANO_STORE_RELEASE(engTail, tail);
+			if (quit)
+				return;
+		}
+		if (engRunning && engPace.hz != 0)
+		{
+			if (PaceWait(&engPace, &engCpu, ENGINE_IDLE_MS * 1000) == 0)
+			{
+				long slice = engPace.slice;
+				if (EngineRun(slice) < slice)
+					engRunning = 0;
+				EnginePublish();
+			}
+		}
+		else if (engRunning)
+		{
+			/* a short slice means the breakpoint was reached */
+			if (EngineRun(ENGINE_SLICE) < ENGINE_SLICE)
+				engRunning = 0;
+			EnginePublish();
+		}
+		else
+		{
+			NanoSleepMs(ENGINE_IDLE_MS);
+		}
+	}
+}
+
+/* Start the engine thread with a freshly reset CPU */
+int EngineStart(const NANO_CORE* core)
+{
+	if (engStarted)
+		return 0;
+	engCore = core;
+	NanoResetCore(&engCpu, core->bits);
+	engCpu.breakpoint = engBreak;
+	engHead = engTail = 0;
+	engRunning = 0;
+	PaceInit(&engPace, 0);
+	memset(&engStats, 0, sizeof(engStats));
+	EnginePublish();
+	if (NanoThreadStart(&engThread, EngineMain, NULL) < 0)
+		return -1;
+	engStarted = 1;
+	return 0;
+}
+
+void EngineStop(void)
+{
+	if (!engStarted)
+		return;
+	while (EnginePost(ENGINE_QUIT, 0) < 0)
+		EngineSync();
+	EngineSync();
+	NanoThreadJoin(&engThread);
+	engStarted = 0;
+}
+
+/* Queue a command; returns -1 if the queue is full */
+int EnginePost(ENGINE_CMD cmd, unsigned long arg)
+{
+	unsigned head = engHead;
+	ENGINE_MSG* msg;
+	if (head - NANO_LOAD_ACQUIRE(engTail) == ENGINE_QUEUE)
+		return -1;
+	msg = &engQueue[head & QUEUE_MASK];
+	msg->cmd = cmd;
+	msg->arg = arg;
+	NANO_STORE_RELEASE(engHead, head + 1);
+	return 0;
+}
+
+/*
+ *  ===== EngineSync =====
+ *      Wait until the engine has carried out every command posted so
+ *  far.  The caller is the UART consumer, so it keeps draining the
+ *  transmit ring meanwhile in case the engine is waiting for room.
+ */
+void EngineSync(void)
+{
+	unsigned head = engHead;
+	while (engStarted && NANO_LOAD_ACQUIRE(engTail) != head)
+	{
+		UartFlush();
+		NanoSleepMs(1);
+	}
+}
+
+/*
+ *  ===== EngineSnapshot =====
+ *      Copy the last published CPU state and, if stats is not NULL, the
+ *  run counters.  Returns non-zero while the engine is running.
+ */
+int EngineSnapshot(NANO_CPU* cpu, ENGINE_STATS* stats)
+{
+	unsigned seq;
+	int running;
+	do
+	{
+		seq = NANO_LOAD_ACQUIRE(engSeq);
+		*cpu = engShared;
+		running = engSharedRunning;
+		if (stats != NULL)
+			*stats = engSharedStats;
+		NANO_BARRIER();
+	} while ((seq & 1) != 0 || engSeq != seq);
+	return running;
+}
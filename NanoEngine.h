@@ -0,0 +1,76 @@
+/* nanoengine.h */
+
+#ifndef __NANOENGINE_H__
+#define __NANOENGINE_H__
+
+#include "NanoCpu.h"
+#include "NanoThread.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *  Simulation engine thread
+ *
+ *  The engine owns the CPU and runs on its own thread; a front end only
+ *  posts commands and reads snapshots.  Commands travel through a single
+ *  producer / single consumer ring, so the front end never blocks on the
+ *  engine.  While running, the engine executes slices of ENGINE_SLICE
+ *  instructions with the fast engine and checks for commands between
+ *  them, so Break is seen within a fraction of a millisecond.
+ *
+ *  After every slice or command the engine publishes the CPU state under
+ *  a sequence lock: readers retry until they copy a state the engine was
+ *  not in the middle of writing, and the engine never waits for them.
+ *  Run counters for performance displays are published the same way.
+ *
+ *  With ENGINE_PACE the slices are paced to a target clock (NanoPace.h)
+ *  and the deadline is awaited in naps of ENGINE_IDLE_MS, so commands
+ *  are seen just as quickly.
+ *
+ *  Memory and devices belong to the engine while it runs.  Stop it
+ *  (ENGINE_BREAK, then EngineSync) before loading memory, and send
+ *  GPIO input through ENGINE_INPUT rather than calling the device.
+ */
+
+#define ENGINE_SLICE		100000		/* instructions between command checks */
+#define ENGINE_QUEUE		64			/* commands, power of 2 */
+#define ENGINE_IDLE_MS		2			/* command poll while stopped */
+
+#define ENGINE_NO_BREAK		0xFFFF		/* breakpoint no instruction can hit */
+#define ENGINE_CLOCK_HZ		25000000	/* clock for simulated time when not paced */
+
+typedef enum
+{
+	ENGINE_GO,				/* run until breakpoint or ENGINE_BREAK */
+	ENGINE_BREAK,			/* stop running */
+	ENGINE_STEP,			/* arg: NANO_STEP */
+	ENGINE_RESET,			/* reset the CPU (breakpoint kept) */
+	ENGINE_BREAKPOINT,		/* arg: address or ENGINE_NO_BREAK */
+	ENGINE_INPUT,			/* arg: GPIO input word */
+	ENGINE_PACE,			/* arg: target clock in Hz, 0 for full speed */
+	ENGINE_HEAT,			/* arg: non-zero to count accesses (MemSetHeat) */
+	ENGINE_QUIT
+} ENGINE_CMD;
+
+typedef struct
+{
+	unsigned long long insts;	/* instructions run since EngineStart */
+	unsigned long long cycles;	/* cycles they took */
+	NANO_USEC us;				/* wall clock when published */
+	unsigned long hz;			/* clock simulated time is measured in */
+} ENGINE_STATS;
+
+int EngineStart(const NANO_CORE* core);
+void EngineStop(void);
+int EnginePost(ENGINE_CMD cmd, unsigned long arg);
+void EngineSync(void);
+int EngineSnapshot(NANO_CPU* cpu, ENGINE_STATS* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOENGINE_H__ */
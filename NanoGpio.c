@@ -0,0 +1,40 @@
+#include "NanoGpio.h"
+#include "NanoVcd.h"
+
+NANO_WORD led_out = 0xFF;
+NANO_WORD sw_inp = 0xFF;
+
+volatile unsigned long gpioChanges = 0;
+
+static int GpioRead(void* ctx, NANO_ADDR addr, NANO_SHORT* data)
+{
+	*data = sw_inp;
+	return 1;
+}
+
+static int GpioWrite(void* ctx, NANO_ADDR addr, NANO_SHORT data)
+{
+	if (data != led_out)
+	{
+		led_out = data;
+		++gpioChanges;
+		VCD_CHANGE(VCD_GPIO_OUT, data);
+	}
+	return 1;
+}
+
+static const NANO_DEVICE gpioDevice =
+{
+	"gpio", GpioRead, GpioWrite, NULL
+};
+
+void GpioInit(void)
+{
+	MemMapDevice(GPIO_PORT, MEM_PAGE_SIZE, &gpioDevice);
+}
+
+void GpioSetInput(NANO_WORD inp)
+{
+	sw_inp = inp;
+	VCD_CHANGE(VCD_GPIO_IN, inp);
+}
@@ -0,0 +1,33 @@
+/* nanogpio.h */
+
+#ifndef __NANOGPIO_H__
+#define __NANOGPIO_H__
+
+#include "NanoMem.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *  GPIO port
+ *
+ *  Guest writes go to led_out and guest reads come from the sw_inp input
+ *  latch, both plain registers.  gpioChanges is bumped whenever led_out
+ *  changes so a front end can poll it at its own refresh rate, and
+ *  pushes switch changes into the latch with GpioSetInput.
+ */
+
+#define GPIO_PORT		0xFE00
+
+extern volatile unsigned long gpioChanges;
+
+void GpioInit(void);
+void GpioSetInput(NANO_WORD inp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOGPIO_H__ */
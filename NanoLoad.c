@@ -0,0 +1,483 @@
+#include <stdlib.h>
+#include <string.h>
+#include "NanoLoad.h"
+#include "NanoMem.h"
+#include "NanoThread.h"
+#include "WTL/IntelHex.h"
+#include "WTL/SRecord.h"
+
+typedef int (*LOAD_PARSE)(const char* line, HEX_RECORD* record);
+
+/* Run of consecutive bytes waiting for MemWriteBlock */
+typedef struct
+{
+	NANO_ADDR addr;
+	NANO_ADDR length;
+	NANO_ADDR size;				/* end of loadable memory */
+	unsigned char data[LOAD_BLOCK];
+} LOAD_RUN;
+
+static void LoadFlush(LOAD_RUN* run)
+{
+	MemWriteBlock(run->addr, run->data, run->length);
+	run->addr += run->length;
+	run->length = 0;
+}
+
+/* Add bytes at addr, starting a new run unless they follow the last */
+static int LoadBytes(LOAD_RUN* run, HEX_ADDR addr, const unsigned char* data, int length)
+{
+	if (addr >= run->size || (HEX_ADDR) length > run->size - addr)
+		return HEX_ADDR_ERROR;
+	if (addr != run->addr + run->length)
+	{
+		LoadFlush(run);
+		run->addr = (NANO_ADDR) addr;
+	}
+	while (length > 0)
+	{
+		int count = LOAD_BLOCK - run->length;
+		if (count > length)
+			count = length;
+		memcpy(&run->data[run->length], data, count);
+		run->length += count;
+		data += count;
+		length -= count;
+		if (run->length == LOAD_BLOCK)
+			LoadFlush(run);
+	}
+	return HEX_DATA;
+}
+
+/* Intel HEX or S-records, one per line, up to the end record */
+static int LoadRecords(LOAD_RUN* run, const char* text, LOAD_PARSE parse, int* line)
+{
+	HEX_RECORD record;
+	record.base = 0;
+	record.type = 0;
+	for (*line = 1; *text != '\0'; ++*line)
+	{
+		int result = HEX_OTHER;
+		if (*text != '\r' && *text != '\n')
+			result = parse(text, &record);
+		if (result == HEX_DONE)
+			return 0;
+		if (result == HEX_DATA)
+			result = LoadBytes(run, record.addr, record.buffer, record.length);
+		if (result < 0)
+			return result;
+		text = strchr(text, '\n');
+		if (text == NULL)
+			break;
+		++text;
+	}
+	return HEX_END_ERROR;
+}
+
+/* One hex word per line, anything after it ignored; blank lines are skipped */
+static int LoadWords(LOAD_RUN* run, const char* text, int* line)
+{
+	NANO_ADDR addr = 0;
+	for (*line = 1; *text != '\0'; ++*line)
+	{
+		unsigned word = 0;
+		int digit;
+		while (*text == ' ' || *text == '\t')
+			++text;
+		if (hexDigit[(unsigned char) *text] >= 0)
+		{
+			unsigned char bytes[2];
+			while ((digit = hexDigit[(unsigned char) *text]) >= 0)
+			{
+				word = (word << 4) | digit;
+				++text;
+			}
+			bytes[0] = (unsigned char) (word >> 8);
+			bytes[1] = (unsigned char) word;
+			if (LoadBytes(run, addr, bytes, 2) < 0)
+				return 0;		/* image fills memory: ignore the rest */
+			addr += 2;
+		}
+		else if (*text != '\r' && *text != '\n' && *text != '\0')
+		{
+			return HEX_DATA_ERROR;
+		}
+		text = strchr(text, '\n');
+		if (text == NULL)
+			break;
+		++text;
+	}
+	return 0;
+}
+
+/* Records decoded by one chunk: a run of consecutive bytes */
+typedef struct
+{
+	HEX_ADDR addr;				/* relative to the chunk's entry base unless based */
+	const unsigned char* data;	/* in the chunk's data */
+	unsigned long length;
+	int based;					/* after an 02/04 record in the same chunk */
+	int line;					/* first line, within the chunk */
+	int seq;					/* file order, for the merge */
+} LOAD_SPAN;
+
+typedef struct
+{
+	const char* text;			/* whole lines of the file */
+	const char* end;
+	int lines;					/* lines parsed */
+	int result;					/* 0 or error */
+	int done;					/* the end record was parsed */
+	int based;					/* an 02/04 record set base */
+	HEX_ADDR base;				/* base on leaving the chunk */
+	unsigned char* data;
+	unsigned long used;
+	LOAD_SPAN* spans;
+	int nspans;
+	int maxspans;
+	NANO_THREAD thread;
+} LOAD_CHUNK;
+
+/* Append a record to the chunk, extending the last span if it follows on */
+static int ChunkAdd(LOAD_CHUNK* chunk, const HEX_RECORD* record, int based, int line)
+{
+	LOAD_SPAN* span = (chunk->nspans > 0) ? &chunk->spans[chunk->nspans - 1] : NULL;
+	if (span == NULL || span->based != based ||
+		span->addr + span->length != record->addr || span->data + span->length != chunk->data + chunk->used)
+	{
+		if (chunk->nspans == chunk->maxspans)
+		{
+			int max = chunk->maxspans ? chunk->maxspans * 2 : 64;
+			LOAD_SPAN* spans = (LOAD_SPAN*) realloc(chunk->spans, max * sizeof(LOAD_SPAN));
+			if (spans == NULL)
+				return HEX_ERROR;
+			chunk->spans = spans;
+			chunk->maxspans = max;
+		}
+		span = &chunk->spans[chunk->nspans++];
+		span->addr = record->addr;
+		span->data = chunk->data + chunk->used;
+		span->length = 0;
+		span->based = based;
+		span->line = line;
+	}
+	memcpy(&chunk->data[chunk->used], record->buffer, record->length);
+	chunk->used += record->length;
+	span->length += record->length;
+	return HEX_DATA;
+}
+
+/* The line at text, copied to last if the view has no terminator to stop at */
+static const char* ChunkLine(const char* text, const char* end, char* last, const char** eol)
+{
+	*eol = (const char*) memchr(text, '\n', end - text);
+	if (*eol == NULL)
+	{
+		/* the file's last line */
+		size_t length = end - text;
+		if (length >= HEX_LINE_BUF)
+			length = HEX_LINE_BUF - 1;
+		memcpy(last, text, length);
+		last[length] = '\0';
+		*eol = end;
+		return last;
+	}
+	return text;
+}
+
+/*
+ *  ===== ChunkParse =====
+ *      Thread body: decode the Intel HEX records of one chunk.  The chunk
+ *  starts with a base of 0; addresses are made absolute in the merge once
+ *  the base left by the chunks before is known, unless an 02/04 record in
+ *  the chunk has already set it.
+ */
+static void ChunkParse(void* arg)
+{
+	LOAD_CHUNK* chunk = (LOAD_CHUNK*) arg;
+	const char* text = chunk->text;
+	HEX_RECORD record;
+	int based = 0;
+
+	record.base = 0;
+	chunk->data = (unsigned char*) malloc((chunk->end - text) / 2 + 1);
+	chunk->result = (chunk->data == NULL) ? HEX_ERROR : 0;
+	while (text < chunk->end && chunk->result == 0 && !chunk->done)
+	{
+		char last[HEX_LINE_BUF];
+		const char* eol;
+		const char* line = ChunkLine(text, chunk->end, last, &eol);
+		int result = HEX_OTHER;
+
+		++chunk->lines;
+		if (*line != '\r' && *line != '\n' && *line != '\0')
+			result = ParseIntelHex(line, &record);
+		if (result == HEX_DATA)
+			result = ChunkAdd(chunk, &record, based, chunk->lines);
+		else if (result == HEX_OTHER && (record.type == 2 || record.type == 4))
+			based = 1;
+		if (result == HEX_DONE)
+			chunk->done = 1;
+		else if (result < 0)
+			chunk->result = result;
+		text = eol + 1;
+	}
+	chunk->based = based;
+	chunk->base = record.base;
+}
+
+/*
+ *  ===== SpanLine =====
+ *      Line within the chunk of the first record of span that does not
+ *  fit below size.  Spans merge consecutive records, so the records are
+ *  parsed again from the span's first line; only called for an error.
+ */
+static int SpanLine(const LOAD_CHUNK* chunk, const LOAD_SPAN* span, NANO_ADDR size)
+{
+	const char* text = chunk->text;
+	HEX_RECORD record;
+	HEX_ADDR addr = span->addr;
+	int n;
+
+	for (n = 1; n < span->line && text < chunk->end; ++n)
+		text = (const char*) memchr(text, '\n', chunk->end - text) + 1;
+	record.base = 0;
+	for (; text < chunk->end; ++n)
+	{
+		char last[HEX_LINE_BUF];
+		const char* eol;
+		const char* line = ChunkLine(text, chunk->end, last, &eol);
+		if (*line != '\r' && *line != '\n' && *line != '\0' &&
+			ParseIntelHex(line, &record) == HEX_DATA)
+		{
+			if (addr >= size || (HEX_ADDR) record.length > size - addr)
+				return n;
+			addr += record.length;
+		}
+		text = eol + 1;
+	}
+	return span->line;
+}
+
+static int SpanCompare(const void* a, const void* b)
+{
+	const LOAD_SPAN* x = *(const LOAD_SPAN* const*) a;
+	const LOAD_SPAN* y = *(const LOAD_SPAN* const*) b;
+	if (x->addr != y->addr)
+		return (x->addr < y->addr) ? -1 : 1;
+	return x->seq - y->seq;
+}
+
+static int SpanCompareSeq(const void* a, const void* b)
+{
+	return (*(const LOAD_SPAN* const*) a)->seq - (*(const LOAD_SPAN* const*) b)->seq;
+}
+
+/*
+ *  ===== LoadIntelHex =====
+ *      Split the file into chunks at line boundaries, decode them in
+ *  parallel, then resolve each chunk's addresses with the base left by
+ *  the chunks before it and store the data in address order (file order
+ *  if records overlap).  Returns 0 or the first error in the file;
+ *  nothing is stored after an error.
+ */
+static int LoadIntelHex(LOAD_RUN* run, const char* text, size_t length, int* line)
+{
+	LOAD_CHUNK chunk[LOAD_MAX_THREADS];
+	int started[LOAD_MAX_THREADS];
+	LOAD_SPAN** order;
+	const char* start = text;
+	const char* end = text + length;
+	int nchunks = (int) (length / LOAD_CHUNK_MIN) + 1;
+	int nspans = 0;
+	int result = HEX_END_ERROR;			/* until the end record is found */
+	HEX_ADDR base = 0;
+	int i, j;
+
+	if (nchunks > NanoThreadCount())
+		nchunks = NanoThreadCount();
+	if (nchunks > LOAD_MAX_THREADS)
+		nchunks = LOAD_MAX_THREADS;
+	memset(chunk, 0, sizeof(chunk));
+	for (i = 0; i < nchunks; ++i)
+	{
+		const char* split = text + length * (i + 1) / nchunks;
+		if (split < start)
+			split = start;
+		while (split > text && split < end && split[-1] != '\n')
+			++split;
+		chunk[i].text = start;
+		chunk[i].end = split;
+		start = split;
+	}
+
+	/* the last chunk is parsed on this thread */
+	for (i = 0; i < nchunks - 1; ++i)
+	{
+		started[i] = (NanoThreadStart(&chunk[i].thread, ChunkParse, &chunk[i]) == 0);
+		if (!started[i])
+			ChunkParse(&chunk[i]);
+	}
+	ChunkParse(&chunk[nchunks - 1]);
+	for (i = 0; i < nchunks - 1; ++i)
+	{
+		if (started[i])
+			NanoThreadJoin(&chunk[i].thread);
+	}
+
+	/* resolve addresses in file order, stopping at the end record or an error */
+	for (i = 0; i < nchunks; ++i)
+		nspans += chunk[i].nspans;
+	order = (LOAD_SPAN**) malloc((nspans + 1) * sizeof(LOAD_SPAN*));
+	if (order == NULL)
+		result = HEX_ERROR;
+	nspans = 0;
+	*line = 0;
+	for (i = 0; i < nchunks && result == HEX_END_ERROR; ++i)
+	{
+		LOAD_CHUNK* c = &chunk[i];
+		for (j = 0; j < c->nspans; ++j)
+		{
+			LOAD_SPAN* span = &c->spans[j];
+			if (!span->based)
+				span->addr += base;
+			if (span->addr >= run->size || span->length > run->size - span->addr)
+			{
+				result = HEX_ADDR_ERROR;
+				*line += SpanLine(c, span, run->size);
+				break;
+			}
+			span->seq = nspans;
+			order[nspans++] = span;
+		}
+		if (result != HEX_END_ERROR)
+			break;
+		*line += c->lines;
+		if (c->result < 0)
+			result = c->result;
+		else if (c->done)
+			result = 0;
+		base = c->based ? c->base : base + c->base;
+	}
+
+	if (result == 0)
+	{
+		*line = 0;
+		qsort(order, nspans, sizeof(LOAD_SPAN*), SpanCompare);
+		for (i = 1; i < nspans; ++i)
+		{
+			/* overlapping data: the last in the file has to win */
+			if (order[i]->addr < order[i - 1]->addr + order[i - 1]->length)
+			{
+				qsort(order, nspans, sizeof(LOAD_SPAN*), SpanCompareSeq);
+				break;
+			}
+		}
+		for (i = 0; i < nspans; ++i)
+			LoadBytes(run, order[i]->addr, order[i]->data, (int) order[i]->length);
+	}
+	for (i = 0; i < nchunks; ++i)
+	{
+		free(chunk[i].data);
+		free(chunk[i].spans);
+	}
+	free(order);
+	return result;
+}
+
+/* Read a whole file into a NUL terminated buffer */
+static char* LoadText(const char* path)
+{
+	FILE* fp = fopen(path, "rb");
+	char* text = NULL;
+	long length;
+	if (fp == NULL)
+		return NULL;
+	if (fseek(fp, 0, SEEK_END) == 0 && (length = ftell(fp)) >= 0 && fseek(fp, 0, SEEK_SET) == 0)
+	{
+		text = (char*) malloc(length + 1);
+		if (text != NULL)
+		{
+			length = (long) fread(text, 1, length, fp);
+			text[length] = '\0';
+		}
+	}
+	fclose(fp);
+	return text;
+}
+
+/*
+ *  ===== LoadImage =====
+ *      Load the image at path into memory below size.  Returns 0 or a
+ *  negative HEX_xxx code (HEX_ERROR if the file cannot be read), with
+ *  *line set to the line in error.
+ */
+int LoadImage(const char* path, NANO_ADDR size, int* line)
+{
+	const char* ext = strrchr(path, '.');
+	LOAD_RUN* run;
+	const char* view;
+	size_t length;
+	char* text;
+	int result;
+
+	*line = 0;
+	if (ext != NULL && strcmp(ext, ".bin") == 0)
+	{
+		/* copy-on-write mapping of the image, no copy at startup */
+		return (MemMapFile(0, size, path, MEM_MAP_RAM) < 0) ? HEX_ERROR : 0;
+	}
+	run = (LOAD_RUN*) malloc(sizeof(LOAD_RUN));
+	if (run == NULL)
+		return HEX_ERROR;
+	run->addr = 0;
+	run->length = 0;
+	run->size = size;
+	view = MemViewFile(path, &length);
+	if (view != NULL && view[0] == ':')
+	{
+		result = LoadIntelHex(run, view, length, line);
+		MemReleaseView(view, length);
+		LoadFlush(run);
+		free(run);
+		return result;
+	}
+	if (view != NULL)
+		MemReleaseView(view, length);
+	text = LoadText(path);
+	if (text == NULL)
+	{
+		free(run);
+		return HEX_ERROR;
+	}
+	if (text[0] == 'S')
+		result = LoadRecords(run, text, ParseMotorolaSRecord, line);
+	else
+		result = LoadWords(run, text, line);
+	LoadFlush(run);
+	free(run);
+	free(text);
+	return result;
+}
+
+const char* LoadError(int result)
+{
+	switch (result)
+	{
+	case HEX_END_ERROR:
+		return "missing or misplaced end record";
+	case HEX_CHECKSUM_ERROR:
+		return "checksum error";
+	case HEX_DATA_ERROR:
+		return "bad data";
+	case HEX_ADDR_ERROR:
+		return "address outside memory";
+	case HEX_LENGTH_ERROR:
+		return "bad record length";
+	case HEX_FORMAT_ERROR:
+		return "unknown record";
+	case HEX_ERROR:
+		return "cannot read file";
+	}
+	return "no error";
+}
@@ -0,0 +1,49 @@
+/* nanoload.h */
+
+#ifndef __NANOLOAD_H__
+#define __NANOLOAD_H__
+
+#include "NanoCpu.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *  Memory image loading
+ *
+ *  A .bin image is mapped copy-on-write (MemMapFile).  Any other file is
+ *  viewed or read in one go and its format taken from its first character:
+ *
+ *      :       Intel HEX records (WTL/IntelHex.c)
+ *      S       Motorola S-records, S19, S28 or S37 (WTL/SRecord.c)
+ *      other   one hex word per line, from address 0
+ *
+ *  Record checksums are verified.  Data is gathered into runs of
+ *  consecutive bytes and stored with MemWriteBlock, so a record costs a
+ *  copy rather than a bus store per word.  Nothing may be stored at or
+ *  above size.
+ *
+ *  Intel HEX is parsed straight from a read-only view of the file, split
+ *  at line boundaries into a chunk per processor (at least LOAD_CHUNK_MIN
+ *  bytes each).  A chunk cannot know the base address set by 02/04
+ *  records before it, so its addresses are made absolute after all the
+ *  chunks are parsed.  The data is then stored in address order, or in
+ *  file order if any records overlap, so the last one in the file wins as
+ *  when loading line by line.  Nothing is stored if there is an error;
+ *  the one reported is the first in the file.
+ */
+
+#define LOAD_BLOCK		4096		/* bytes gathered per MemWriteBlock */
+#define LOAD_CHUNK_MIN	(256 * 1024)	/* smallest Intel HEX chunk */
+#define LOAD_MAX_THREADS	16
+
+int LoadImage(const char* path, NANO_ADDR size, int* line);
+const char* LoadError(int result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOLOAD_H__ */
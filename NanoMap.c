@@ -0,0 +1,227 @@
+#include "NanoMem.h"
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+typedef struct
+{
+	NANO_ADDR addr;				/* first mapped address */
+	NANO_ADDR size;				/* bytes of address space mapped */
+	void* base;					/* host view of the file */
+	size_t length;				/* length of host view */
+#ifdef _WIN32
+	HANDLE hMap;
+#endif
+	int used;					/* slot in use */
+} NANO_MAP;
+
+static NANO_MAP memMap[MEM_MAX_MAPS];
+
+/*
+ *  ===== MapView =====
+ *      Map up to max bytes of path into the host address space.  Returns
+ *  the view and its length, or NULL if the file cannot be mapped.
+ */
+#ifdef _WIN32
+static void* MapView(NANO_MAP* map, const char* path, size_t max, int flags)
+{
+	DWORD access = GENERIC_READ;
+	DWORD protect = PAGE_READONLY;
+	DWORD view = FILE_MAP_READ;
+	HANDLE hFile;
+	LARGE_INTEGER size;
+
+	if (flags & MEM_MAP_PERSIST)
+	{
+		access |= GENERIC_WRITE;
+		protect = PAGE_READWRITE;
+		view = FILE_MAP_WRITE;
+	}
+	else if (flags & MEM_MAP_RAM)
+	{
+		protect = PAGE_WRITECOPY;
+		view = FILE_MAP_COPY;
+	}
+	hFile = CreateFileA(path, access, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return NULL;
+	if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(hFile);
+		return NULL;
+	}
+	map->length = (size.QuadPart < (LONGLONG) max) ? (size_t) size.QuadPart : max;
+	map->hMap = CreateFileMappingA(hFile, NULL, protect, 0, 0, NULL);
+	CloseHandle(hFile);
+	if (map->hMap == NULL)
+		return NULL;
+	map->base = MapViewOfFile(map->hMap, view, 0, 0, map->length);
+	if (map->base == NULL)
+	{
+		CloseHandle(map->hMap);
+		return NULL;
+	}
+	return map->base;
+}
+
+static void UnmapView(NANO_MAP* map)
+{
+	if (map->base != NULL)
+	{
+		UnmapViewOfFile(map->base);
+		CloseHandle(map->hMap);
+	}
+}
+#else
+static void* MapView(NANO_MAP* map, const char* path, size_t max, int flags)
+{
+	int prot = PROT_READ;
+	int share = MAP_SHARED;
+	int fd;
+	struct stat st;
+	void* base;
+
+	if (flags & MEM_MAP_RAM)
+	{
+		prot |= PROT_WRITE;
+		if ((flags & MEM_MAP_PERSIST) == 0)
+			share = MAP_PRIVATE;
+	}
+	fd = open(path, (flags & MEM_MAP_PERSIST) ? O_RDWR : O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0 || st.st_size == 0)
+	{
+		close(fd);
+		return NULL;
+	}
+	map->length = ((size_t) st.st_size < max) ? (size_t) st.st_size : max;
+	/* the mapping stays valid after the descriptor is closed */
+	base = mmap(NULL, map->length, prot, share, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return NULL;
+	map->base = base;
+	return base;
+}
+
+static void UnmapView(NANO_MAP* map)
+{
+	if (map->base != NULL)
+		munmap(map->base, map->length);
+}
+#endif
+
+/*
+ *  ===== MemMapFile =====
+ *      Back the page aligned region starting at addr with up to size bytes
+ *  of the file path (size 0 = up to the I/O window).  Regions never reach
+ *  into the I/O window, so devices are not replaced and unmapping always
+ *  restores plain RAM.  A trailing partial page reads as zero beyond end
+ *  of file; host pages are at least MEM_PAGE_SIZE so the view covers it.
+ *  Returns the number of bytes mapped or -1 on error.
+ */
+int MemMapFile(NANO_ADDR addr, NANO_ADDR size, const char* path, int flags)
+{
+	NANO_MAP* map = NULL;
+	NANO_ADDR pages;
+	int i;
+
+	if ((addr & (MEM_PAGE_SIZE - 1)) || addr >= MEM_IO_BASE)
+		return -1;
+	if (size == 0 || size > MEM_IO_BASE - addr)
+		size = MEM_IO_BASE - addr;
+	for (i = 0; i < MEM_MAX_MAPS; ++i)
+	{
+		if (!memMap[i].used)
+		{
+			map = &memMap[i];
+			break;
+		}
+	}
+	if (map == NULL)
+		return -1;
+	memset(map, 0, sizeof(NANO_MAP));
+	if (MapView(map, path, size, flags) == NULL)
+		return -1;
+
+	/* drop any mapping the new region overlaps */
+	pages = (NANO_ADDR) ((map->length + MEM_PAGE_SIZE - 1) & ~(size_t) (MEM_PAGE_SIZE - 1));
+	for (i = 0; i < MEM_MAX_MAPS; ++i)
+	{
+		NANO_MAP* old = &memMap[i];
+		if (old->used && old->addr < addr + pages && addr < old->addr + old->size)
+			MemUnmapFile(old->addr);
+	}
+
+	map->addr = addr;
+	map->size = pages;
+	map->used = 1;
+	if (flags & MEM_MAP_RAM)
+		MemMapRam(addr, pages, (NANO_SHORT*) map->base);
+	else
+		MemMapRom(addr, pages, (NANO_SHORT*) map->base);
+	return (int) map->length;
+}
+
+/* Unmap the file region containing addr and restore its default pages */
+void MemUnmapFile(NANO_ADDR addr)
+{
+	int i;
+	for (i = 0; i < MEM_MAX_MAPS; ++i)
+	{
+		NANO_MAP* map = &memMap[i];
+		if (map->used && addr >= map->addr && addr < map->addr + map->size)
+		{
+			MemUnmap(map->addr, map->size);
+			UnmapView(map);
+			memset(map, 0, sizeof(NANO_MAP));
+		}
+	}
+}
+
+/*
+ *  ===== MemViewFile =====
+ *      Map the whole of path read-only for parsing, outside the bus.
+ *  Returns the view and its length, or NULL for a missing or empty file.
+ *  The view is not NUL terminated.
+ */
+const char* MemViewFile(const char* path, size_t* length)
+{
+	NANO_MAP map;
+	memset(&map, 0, sizeof(NANO_MAP));
+	if (MapView(&map, path, (size_t) -1, MEM_MAP_ROM) == NULL)
+		return NULL;
+#ifdef _WIN32
+	CloseHandle(map.hMap);			/* the view keeps the mapping open */
+#endif
+	*length = map.length;
+	return (const char*) map.base;
+}
+
+void MemReleaseView(const char* view, size_t length)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(view);
+#else
+	munmap((void*) view, length);
+#endif
+}
+
+void MemUnmapFiles(void)
+{
+	int i;
+	for (i = 0; i < MEM_MAX_MAPS; ++i)
+	{
+		if (memMap[i].used)
+			MemUnmapFile(memMap[i].addr);
+	}
+}
@@ -1,59 +1,485 @@
-#include "NanoCpu.h"
+#include "NanoMem.h"
+#include <string.h>
 
-#define MEM_WORDS   32768
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MEM_SSE2
+#include <emmintrin.h>
+#endif
 
-NANO_WORD led_out = 0xFF;
-NANO_WORD sw_inp = 0xFF;
+#define MEM_WORDS   NANO_MEM_WORDS
 
 NANO_SHORT memory[MEM_WORDS];
 
+NANO_PAGE memPage[MEM_PAGES];
+
+NANO_FAR_MAP memFarMap = NULL;
+
+NANO_BUS_TRACE memTrace = NULL;
+unsigned long (*memHeat)[MEM_HEAT_BLOCKS] = NULL;
+static unsigned long memHeatCount[MEM_HEAT_KINDS][MEM_HEAT_BLOCKS];
+
+static int memInit = 0;
+static int memSlow = 0;
+
+typedef struct
+{
+	NANO_CODE_WATCH watch;
+	void* ctx;
+} NANO_WATCH;
+
+static NANO_WATCH memWatch[MEM_MAX_WATCH];
+
 #define ILLEGAL_ADDR(a)     (((a) & 1) || (a >= MEM_WORDS * 2))
+#define FAR_ADDR(a)			((a) >= MEM_WORDS * 2)
 #define IO_ADDR(a)			(((a) & 0xC000) == 0xC000)
 
-int MemReadWord(NANO_ADDR addr, NANO_SHORT* data)
+/* Unmapped I/O: read as MEM_UNMAPPED, ignore writes */
+static int NoDevRead(void* ctx, NANO_ADDR addr, NANO_SHORT* data)
 {
-	if (ILLEGAL_ADDR(addr))
-		return -1;
+	*data = MEM_UNMAPPED;
+	return 1;
+}
+
+static int NoDevWrite(void* ctx, NANO_ADDR addr, NANO_SHORT data)
+{
+	return 1;
+}
+
+static const NANO_DEVICE noDevice =
+{
+	"none", NoDevRead, NoDevWrite, NULL
+};
+
+/* Tell code watchers that size bytes at addr have changed */
+static void MemCodeWritten(NANO_ADDR addr, NANO_ADDR size)
+{
+	int i;
+	for (i = 0; i < MEM_MAX_WATCH; ++i)
+	{
+		if (memWatch[i].watch != NULL)
+			memWatch[i].watch(memWatch[i].ctx, addr, size);
+	}
+}
+
+/* Page contents are being replaced: invalidate code views of it */
+static void MemPageReplaced(NANO_PAGE* page)
+{
+	if (page->flags & MEM_CODE)
+		MemCodeWritten((NANO_ADDR) (page - memPage) << MEM_PAGE_SHIFT, MEM_PAGE_SIZE);
+	MEM_PAGE_DIRTY(page);
+}
+
+/* Set the inline access pointers from the page's backing and flags */
+static void MemFastPaths(NANO_PAGE* page)
+{
+	if (page->ram == NULL || memTrace != NULL || memHeat != NULL || memSlow)
+	{
+		page->rd = page->wr = page->ex = NULL;
+		return;
+	}
+	page->rd = page->ram;
+	page->wr = (page->flags & (MEM_ROM | MEM_CODE)) ? NULL : page->ram;
+	page->ex = (page->flags & MEM_CODE) ? page->ram : NULL;
+}
+
+/* Restore default page (RAM below the I/O window, else unmapped I/O) */
+static void MemDefaultPage(int n)
+{
+	NANO_PAGE* page = &memPage[n];
+	NANO_ADDR addr = (NANO_ADDR) n << MEM_PAGE_SHIFT;
+	MemPageReplaced(page);
 	if (IO_ADDR(addr))
-		*data = InpReadWord(addr);
+	{
+		page->ram = NULL;
+		page->dev = &noDevice;
+		page->flags = 0;
+	}
 	else
-		*data = memory[addr >> 1];
+	{
+		page->ram = &memory[addr >> 1];
+		page->dev = NULL;
+		page->flags = MEM_RAM;
+	}
+	MemFastPaths(page);
+}
+
+void MemInitMap(void)
+{
+	int n;
+	for (n = 0; n < MEM_PAGES; ++n)
+		MemDefaultPage(n);
+	memInit = 1;
+}
+
+#define MEM_INIT()	{ if (!memInit) MemInitMap(); }
+
+#define MEM_TRACE(addr, data, kind)	{ if (memTrace != NULL) memTrace(addr, data, kind); }
+#define MEM_HEAT(addr, kind)		{ if (memHeat != NULL) ++memHeat[kind][(addr) >> MEM_HEAT_SHIFT]; }
+
+/*
+ *  ===== MemSetTrace =====
+ *      Install (or with NULL remove) a bus trace hook.  While one is
+ *  installed every page takes the slow path, so all CPU loads and stores
+ *  below the far area reach it.
+ */
+void MemSetTrace(NANO_BUS_TRACE trace)
+{
+	int n;
+	MEM_INIT();
+	memTrace = trace;
+	for (n = 0; n < MEM_PAGES; ++n)
+		MemFastPaths(&memPage[n]);
+}
+
+/* Send every page down the slow path (e.g. for a reference run), or not */
+void MemSetSlow(int on)
+{
+	int n;
+	MEM_INIT();
+	memSlow = on;
+	for (n = 0; n < MEM_PAGES; ++n)
+		MemFastPaths(&memPage[n]);
+}
+
+/* Start counting accesses from zero, or stop counting */
+void MemSetHeat(int on)
+{
+	int n;
+	MEM_INIT();
+	if (on)
+		memset(memHeatCount, 0, sizeof(memHeatCount));
+	memHeat = on ? memHeatCount : NULL;
+	for (n = 0; n < MEM_PAGES; ++n)
+		MemFastPaths(&memPage[n]);
+}
+
+/* Counts of kind MEM_HEAT_xxx, MEM_HEAT_BLOCKS of them */
+const volatile unsigned long* MemHeatCounts(int kind)
+{
+	return memHeatCount[kind];
+}
+
+/* Map size bytes of host words (RAM or ROM) starting at page aligned addr */
+static void MemMapWords(NANO_ADDR addr, NANO_ADDR size, NANO_SHORT* words, int flags)
+{
+	NANO_ADDR end = addr + size;
+	MEM_INIT();
+	for (; addr < end && addr < MEM_SIZE; addr += MEM_PAGE_SIZE)
+	{
+		NANO_PAGE* page = &memPage[MEM_PAGE_NUM(addr)];
+		MemPageReplaced(page);
+		page->ram = words;
+		page->dev = NULL;
+		page->flags = flags;
+		MemFastPaths(page);
+		words += MEM_PAGE_WORDS;
+	}
+}
+
+void MemMapRam(NANO_ADDR addr, NANO_ADDR size, NANO_SHORT* words)
+{
+	MemMapWords(addr, size, words, MEM_RAM);
+}
+
+void MemMapRom(NANO_ADDR addr, NANO_ADDR size, NANO_SHORT* words)
+{
+	MemMapWords(addr, size, words, MEM_RAM | MEM_ROM);
+}
+
+void MemMapDevice(NANO_ADDR addr, NANO_ADDR size, const NANO_DEVICE* dev)
+{
+	NANO_ADDR end = addr + size;
+	MEM_INIT();
+	for (; addr < end && addr < MEM_SIZE; addr += MEM_PAGE_SIZE)
+	{
+		NANO_PAGE* page = &memPage[MEM_PAGE_NUM(addr)];
+		MemPageReplaced(page);
+		page->rd = page->wr = page->ex = page->ram = NULL;
+		page->dev = dev;
+		page->flags = 0;
+	}
+}
+
+void MemUnmap(NANO_ADDR addr, NANO_ADDR size)
+{
+	NANO_ADDR end = addr + size;
+	MEM_INIT();
+	for (; addr < end && addr < MEM_SIZE; addr += MEM_PAGE_SIZE)
+		MemDefaultPage(MEM_PAGE_NUM(addr));
+}
+
+/*
+ *  ===== MemSavePages =====
+ *      Copy the page table entries for size bytes at page aligned addr,
+ *  so that whatever is mapped there can be put back with MemRestorePages
+ *  once a remapping (MMU, plugin) is undone.
+ */
+void MemSavePages(NANO_ADDR addr, NANO_ADDR size, NANO_PAGE* saved)
+{
+	NANO_ADDR end = addr + size;
+	MEM_INIT();
+	for (; addr < end && addr < MEM_SIZE; addr += MEM_PAGE_SIZE)
+		*saved++ = memPage[MEM_PAGE_NUM(addr)];
+}
+
+void MemRestorePages(NANO_ADDR addr, NANO_ADDR size, const NANO_PAGE* saved)
+{
+	NANO_ADDR end = addr + size;
+	MEM_INIT();
+	for (; addr < end && addr < MEM_SIZE; addr += MEM_PAGE_SIZE, ++saved)
+	{
+		NANO_PAGE* page = &memPage[MEM_PAGE_NUM(addr)];
+		MemPageReplaced(page);
+		page->ram = saved->ram;
+		page->dev = saved->dev;
+		page->flags = saved->flags & (MEM_RAM | MEM_ROM);
+		MemFastPaths(page);
+	}
+}
+
+/* Far word beyond the page table, or NULL if no MMU maps it */
+static NANO_SHORT* MemFarWord(NANO_ADDR addr)
+{
+	if ((addr & 1) || memFarMap == NULL)
+		return NULL;
+	return memFarMap(addr);
+}
+
+static int MemFarRead(NANO_ADDR addr, NANO_SHORT* data)
+{
+	NANO_SHORT* ptr = MemFarWord(addr);
+	if (ptr == NULL)
+	{
+		*data = MEM_UNMAPPED;
+		return -1;
+	}
+	*data = *ptr;
 	return 1;
 }
 
+int MemReadWord(NANO_ADDR addr, NANO_SHORT* data)
+{
+	NANO_PAGE* page;
+	int result;
+	if (FAR_ADDR(addr))
+		return MemFarRead(addr, data);
+	if (ILLEGAL_ADDR(addr))
+	{
+		*data = MEM_UNMAPPED;
+		return -1;
+	}
+	MEM_INIT();
+	page = &memPage[MEM_PAGE_NUM(addr)];
+	if (page->ram != NULL)
+	{
+		*data = page->ram[MEM_PAGE_IDX(addr)];
+		MEM_TRACE(addr, *data, MEM_TRACE_READ);
+		MEM_HEAT(addr, MEM_HEAT_READ);
+		return 1;
+	}
+	result = page->dev->read(page->dev->ctx, addr, data);
+	if (result < 0)
+		*data = MEM_UNMAPPED;
+	MEM_TRACE(addr, *data, MEM_TRACE_READ);
+	MEM_HEAT(addr, MEM_HEAT_READ);
+	return result;
+}
+
+/* Read word holding byte addr; devices see the byte address */
+int MemReadByte(NANO_ADDR addr, NANO_SHORT* data)
+{
+	NANO_PAGE* page;
+	int result;
+	if (FAR_ADDR(addr))
+		return MemFarRead(addr & ~1, data);
+	MEM_INIT();
+	page = &memPage[MEM_PAGE_NUM(addr)];
+	if (page->ram != NULL)
+	{
+		*data = page->ram[MEM_PAGE_IDX(addr)];
+		MEM_TRACE(addr, *data, MEM_TRACE_READ);
+		MEM_HEAT(addr, MEM_HEAT_READ);
+		return 1;
+	}
+	result = page->dev->read(page->dev->ctx, addr, data);
+	if (result < 0)
+		*data = MEM_UNMAPPED;
+	MEM_TRACE(addr, *data, MEM_TRACE_READ);
+	MEM_HEAT(addr, MEM_HEAT_READ);
+	return result;
+}
+
+/* Fetch opcode: first fetch from a RAM page turns it into a code page */
+int MemFetchWord(NANO_ADDR addr, NANO_SHORT* data)
+{
+	NANO_PAGE* page;
+	int result;
+	if (FAR_ADDR(addr))
+		return MemFarRead(addr, data);
+	if (ILLEGAL_ADDR(addr))
+	{
+		*data = MEM_UNMAPPED;
+		return -1;
+	}
+	MEM_INIT();
+	page = &memPage[MEM_PAGE_NUM(addr)];
+	MEM_HEAT(addr, MEM_HEAT_EXEC);
+	if (page->ram != NULL)
+	{
+		page->flags |= MEM_CODE;
+		MemFastPaths(page);
+		*data = page->ram[MEM_PAGE_IDX(addr)];
+		return 1;
+	}
+	result = page->dev->read(page->dev->ctx, addr, data);
+	if (result < 0)
+		*data = MEM_UNMAPPED;
+	return result;
+}
+
+/* Return pages to data pages, re-enabling inline stores */
+void MemClearCode(NANO_ADDR addr, NANO_ADDR size)
+{
+	NANO_ADDR end = addr + size;
+	MEM_INIT();
+	for (addr &= ~(NANO_ADDR) (MEM_PAGE_SIZE - 1); addr < end && addr < MEM_SIZE; addr += MEM_PAGE_SIZE)
+	{
+		NANO_PAGE* page = &memPage[MEM_PAGE_NUM(addr)];
+		if (page->flags & MEM_CODE)
+		{
+			page->flags &= ~MEM_CODE;
+			MemFastPaths(page);
+		}
+	}
+}
+
+int MemAddCodeWatch(NANO_CODE_WATCH watch, void* ctx)
+{
+	int i;
+	for (i = 0; i < MEM_MAX_WATCH; ++i)
+	{
+		if (memWatch[i].watch == NULL)
+		{
+			memWatch[i].watch = watch;
+			memWatch[i].ctx = ctx;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+void MemRemoveCodeWatch(NANO_CODE_WATCH watch, void* ctx)
+{
+	int i;
+	for (i = 0; i < MEM_MAX_WATCH; ++i)
+	{
+		if (memWatch[i].watch == watch && memWatch[i].ctx == ctx)
+			memWatch[i].watch = NULL;
+	}
+}
+
 int MemReadLong(NANO_ADDR addr, NANO_LONG* data)
 {
 	NANO_SHORT lo,hi;
 	int result = MemReadWord(addr, &hi);
-	if (result < 0)
-		return result;
-	result = MemReadWord((NANO_ADDR) (addr + 2), &lo);
-	if (result < 0)
-		return result;
+	if (result >= 0)
+		result = MemReadWord((NANO_ADDR) (addr + 2), &lo);
+	else
+		lo = MEM_UNMAPPED;
 	*data = ((NANO_LONG) hi << 16) | (lo);
-	return 2;
+	return (result < 0) ? result : 2;
 }
 
-int MemWriteByte(NANO_ADDR addr, NANO_WORD data)
+/* Store byte: even addresses are the lower byte of a word, as for loads */
+int MemWriteByte(NANO_ADDR addr, NANO_SHORT data)
 {
-	if (IO_ADDR(addr))
-		OutWriteWord(addr, data);
+	NANO_PAGE* page;
+	NANO_SHORT* ptr;
+	if (FAR_ADDR(addr))
+	{
+		ptr = MemFarWord(addr & ~1);
+		if (ptr == NULL)
+			return -1;
+		page = NULL;
+	}
 	else
 	{
-		int8_t* ptr = ((int8_t*)memory) + addr;
-		*ptr = (int8_t) data;
+		MEM_INIT();
+		page = &memPage[MEM_PAGE_NUM(addr)];
+		MEM_TRACE(addr, data, MEM_TRACE_BYTE);
+		MEM_HEAT(addr, MEM_HEAT_WRITE);
+		if (page->ram == NULL)
+			return page->dev->write(page->dev->ctx, addr, data);
+		if (page->flags & MEM_ROM)
+			return 1;
+		ptr = &page->ram[MEM_PAGE_IDX(addr)];
 	}
+	if (addr & 1)
+		*ptr = (*ptr & 0x00FF) | (data << 8);
+	else
+		*ptr = (*ptr & 0xFF00) | (data & 0x00FF);
+	if (page == NULL)
+		return 1;
+	MEM_PAGE_DIRTY(page);
+	if (page->flags & MEM_CODE)
+		MemCodeWritten(addr & ~1, 2);
 	return 1;
 }
 
+/*
+ *  ===== MemWriteFifo =====
+ *      Store count bytes in turn to the byte at addr, as a run of
+ *  MemWriteByte calls would.  A device with a fifo handler takes the
+ *  whole run in one call.  Returns the total cycles, or the first error.
+ */
+int MemWriteFifo(NANO_ADDR addr, const unsigned char* data, NANO_ADDR count)
+{
+	int cycles = 0;
+	NANO_ADDR i;
+	if (!FAR_ADDR(addr))
+	{
+		const NANO_DEVICE* dev;
+		MEM_INIT();
+		dev = memPage[MEM_PAGE_NUM(addr)].dev;
+		if (dev != NULL && dev->fifo != NULL)
+			return dev->fifo(dev->ctx, addr, data, count);
+	}
+	for (i = 0; i < count; ++i)
+	{
+		int result = MemWriteByte(addr, data[i]);
+		if (result < 0)
+			return result;
+		cycles += result;
+	}
+	return cycles;
+}
+
 int MemWriteWord(NANO_ADDR addr, NANO_SHORT data)
 {
+	NANO_PAGE* page;
+	if (FAR_ADDR(addr))
+	{
+		NANO_SHORT* ptr = MemFarWord(addr);
+		if (ptr == NULL)
+			return -1;
+		*ptr = data;
+		return 1;
+	}
 	if (ILLEGAL_ADDR(addr))
 		return -1;
-	if (IO_ADDR(addr))
-		OutWriteWord(addr, data);
-	else
-		memory[addr >> 1] = data;
+	MEM_INIT();
+	page = &memPage[MEM_PAGE_NUM(addr)];
+	MEM_TRACE(addr, data, MEM_TRACE_WRITE);
+	MEM_HEAT(addr, MEM_HEAT_WRITE);
+	if (page->ram == NULL)
+		return page->dev->write(page->dev->ctx, addr, data);
+	if ((page->flags & MEM_ROM) == 0)
+	{
+		page->ram[MEM_PAGE_IDX(addr)] = data;
+		MEM_PAGE_DIRTY(page);
+		if (page->flags & MEM_CODE)
+			MemCodeWritten(addr, 2);
+	}
 	return 1;
 }
 
@@ -65,16 +491,315 @@ int MemWriteLong(NANO_ADDR addr, NANO_LONG data)
 	return MemWriteWord((NANO_ADDR) (addr + 2), (NANO_SHORT) data);
 }
 
-void MemCopyBytes(NANO_ADDR addr, void* buf, int length)
+/* Big-endian bytes of a guest block; words read/written in host order */
+#define BE_WORD(p)		((NANO_SHORT) (((p)[0] << 8) | (p)[1]))
+
+/* Swap big-endian byte pairs to/from host words (symmetric on x86) */
+static void MemSwapIn(NANO_SHORT* dst, const unsigned char* src, NANO_ADDR words)
+{
+#ifdef MEM_SSE2
+	for (; words >= 8; words -= 8, src += 16, dst += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*) src);
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128((__m128i*) dst, v);
+	}
+#endif
+	for (; words > 0; --words, src += 2)
+		*dst++ = BE_WORD(src);
+}
+
+static void MemSwapOut(unsigned char* dst, const NANO_SHORT* src, NANO_ADDR words)
+{
+#ifdef MEM_SSE2
+	for (; words >= 8; words -= 8, src += 8, dst += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*) src);
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128((__m128i*) dst, v);
+	}
+#endif
+	for (; words > 0; --words, dst += 2)
+	{
+		dst[0] = (unsigned char) (*src >> 8);
+		dst[1] = (unsigned char) *src++;
+	}
+}
+
+/* RAM page holding addr, or NULL for device, far or illegal addresses */
+static NANO_PAGE* MemBlockPage(NANO_ADDR addr)
+{
+	NANO_PAGE* page;
+	if (FAR_ADDR(addr))
+		return NULL;
+	MEM_INIT();
+	page = &memPage[MEM_PAGE_NUM(addr)];
+	return (page->ram != NULL) ? page : NULL;
+}
+
+/* Bytes from addr to the end of its page, limited to even length */
+static NANO_ADDR MemBlockChunk(NANO_ADDR addr, NANO_ADDR length)
+{
+	NANO_ADDR count = MEM_PAGE_SIZE - (addr & (MEM_PAGE_SIZE - 1));
+	return (count < length) ? count : (length & ~(NANO_ADDR) 1);
+}
+
+/* Replace one byte of a big-endian block word (even = upper byte) */
+static void MemPatchByte(NANO_ADDR addr, unsigned char byte)
+{
+	NANO_SHORT word = 0;
+	MemReadWord(addr & ~1, &word);
+	if (addr & 1)
+		word = (word & 0xFF00) | byte;
+	else
+		word = (word & 0x00FF) | (byte << 8);
+	MemWriteWord(addr & ~1, word);
+}
+
+/*
+ *  ===== MemWriteBlock =====
+ *      Store length bytes of big-endian data at addr.  Whole words in RAM
+ *  pages are byte swapped straight into the page; device and far words
+ *  go through MemWriteWord and a leading or trailing odd byte is merged
+ *  into its word.
+ */
+void MemWriteBlock(NANO_ADDR addr, const void* buf, NANO_ADDR length)
 {
-	unsigned char* ptr = buf;
+	const unsigned char* ptr = (const unsigned char*) buf;
+
+	if ((addr & 1) && length > 0)
+	{
+		MemPatchByte(addr++, *ptr++);
+		--length;
+	}
+	while (length >= 2)
+	{
+		NANO_ADDR count = MemBlockChunk(addr, length);
+		NANO_PAGE* page = MemBlockPage(addr);
+		if (page == NULL)
+		{
+			NANO_ADDR i;
+			for (i = 0; i < count; i += 2)
+				MemWriteWord(addr + i, BE_WORD(ptr + i));
+		}
+		else if ((page->flags & MEM_ROM) == 0)
+		{
+			MemSwapIn(&page->ram[MEM_PAGE_IDX(addr)], ptr, count >> 1);
+			MEM_PAGE_DIRTY(page);
+			if (page->flags & MEM_CODE)
+				MemCodeWritten(addr, count);
+		}
+		addr += count;
+		ptr += count;
+		length -= count;
+	}
+	if (length > 0)
+		MemPatchByte(addr, *ptr);
+}
+
+/*
+ *  ===== MemReadBlock =====
+ *      Read length bytes at addr as big-endian data.  Device words are
+ *  read through their handlers (with any side effects); bus errors read
+ *  as zero.
+ */
+void MemReadBlock(NANO_ADDR addr, void* buf, NANO_ADDR length)
+{
+	unsigned char* ptr = (unsigned char*) buf;
+	NANO_SHORT word = 0;
+
+	if ((addr & 1) && length > 0)
+	{
+		MemReadWord(addr & ~1, &word);
+		*ptr++ = (unsigned char) word;
+		++addr;
+		--length;
+	}
+	while (length >= 2)
+	{
+		NANO_ADDR count = MemBlockChunk(addr, length);
+		NANO_PAGE* page = MemBlockPage(addr);
+		if (page == NULL)
+		{
+			NANO_ADDR i;
+			for (i = 0; i < count; i += 2)
+			{
+				word = 0;
+				MemReadWord(addr + i, &word);
+				ptr[i] = (unsigned char) (word >> 8);
+				ptr[i + 1] = (unsigned char) word;
+			}
+		}
+		else
+		{
+			MemSwapOut(ptr, &page->ram[MEM_PAGE_IDX(addr)], count >> 1);
+		}
+		addr += count;
+		ptr += count;
+		length -= count;
+	}
+	if (length > 0)
+	{
+		word = 0;
+		MemReadWord(addr, &word);
+		*ptr = (unsigned char) (word >> 8);
+	}
+}
+
+/* Fill length bytes (whole words) at even addr with word */
+void MemFillBlock(NANO_ADDR addr, NANO_SHORT word, NANO_ADDR length)
+{
+	length &= ~(NANO_ADDR) 1;
 	while (length > 0)
 	{
-		NANO_SHORT word = (ptr[0] << 8) | ptr[1];
-		MemWriteWord(addr, word);
-		addr += sizeof(NANO_SHORT);
-		ptr += sizeof(NANO_SHORT);
-		length -= sizeof(NANO_SHORT);
+		NANO_ADDR count = MemBlockChunk(addr, length);
+		NANO_PAGE* page = MemBlockPage(addr);
+		NANO_ADDR i;
+		if (page == NULL)
+		{
+			for (i = 0; i < count; i += 2)
+				MemWriteWord(addr + i, word);
+		}
+		else if ((page->flags & MEM_ROM) == 0)
+		{
+			NANO_SHORT* dst = &page->ram[MEM_PAGE_IDX(addr)];
+			for (i = 0; i < count >> 1; ++i)
+				dst[i] = word;
+			MEM_PAGE_DIRTY(page);
+			if (page->flags & MEM_CODE)
+				MemCodeWritten(addr, count);
+		}
+		addr += count;
+		length -= count;
+	}
+}
+
+void MemCopyBytes(NANO_ADDR addr, void* buf, int length)
+{
+	MemWriteBlock(addr, buf, (NANO_ADDR) length);
+}
+
+/* Copy RAM/ROM pages to image (device pages read as 0) */
+void MemSaveImage(NANO_SHORT* image)
+{
+	int n;
+	MEM_INIT();
+	for (n = 0; n < MEM_PAGES; ++n, image += MEM_PAGE_WORDS)
+	{
+		if (memPage[n].ram != NULL)
+			memcpy(image, memPage[n].ram, MEM_PAGE_SIZE);
+		else
+			memset(image, 0, MEM_PAGE_SIZE);
+	}
+}
+
+/* Copy image to RAM pages (ROM, device and unchanged pages are skipped) */
+void MemLoadImage(const NANO_SHORT* image)
+{
+	int n;
+	MEM_INIT();
+	for (n = 0; n < MEM_PAGES; ++n, image += MEM_PAGE_WORDS)
+	{
+		if (memPage[n].ram != NULL && (memPage[n].flags & MEM_ROM) == 0 &&
+			memcmp(memPage[n].ram, image, MEM_PAGE_SIZE) != 0)
+		{
+			memcpy(memPage[n].ram, image, MEM_PAGE_SIZE);
+			MemPageReplaced(&memPage[n]);
+		}
 	}
 }
 
+/* Non-zero if any page overlapping addr..addr+size-1 is dirty */
+int MemIsDirty(NANO_ADDR addr, NANO_ADDR size)
+{
+	NANO_ADDR end = addr + size;
+	MEM_INIT();
+	for (addr &= ~(NANO_ADDR) (MEM_PAGE_SIZE - 1); addr < end && addr < MEM_SIZE; addr += MEM_PAGE_SIZE)
+	{
+		if (memPage[MEM_PAGE_NUM(addr)].flags & MEM_DIRTY)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ *  ===== MemFindDirty =====
+ *      Find the first run of dirty pages at or above addr.  Returns its
+ *  start address and sets *end to the address after it, or returns
+ *  MEM_SIZE if no page is dirty.
+ */
+NANO_ADDR MemFindDirty(NANO_ADDR addr, NANO_ADDR* end)
+{
+	NANO_ADDR start;
+	MEM_INIT();
+	addr &= ~(NANO_ADDR) (MEM_PAGE_SIZE - 1);
+	while (addr < MEM_SIZE && !(memPage[MEM_PAGE_NUM(addr)].flags & MEM_DIRTY))
+		addr += MEM_PAGE_SIZE;
+	start = addr;
+	while (addr < MEM_SIZE && (memPage[MEM_PAGE_NUM(addr)].flags & MEM_DIRTY))
+		addr += MEM_PAGE_SIZE;
+	*end = addr;
+	return start;
+}
+
+void MemClearDirty(NANO_ADDR addr, NANO_ADDR size)
+{
+	NANO_ADDR end = addr + size;
+	MEM_INIT();
+	for (addr &= ~(NANO_ADDR) (MEM_PAGE_SIZE - 1); addr < end && addr < MEM_SIZE; addr += MEM_PAGE_SIZE)
+		memPage[MEM_PAGE_NUM(addr)].flags &= ~MEM_DIRTY;
+}
+
+unsigned long MemPageGen(NANO_ADDR addr)
+{
+	MEM_INIT();
+	return (addr < MEM_SIZE) ? memPage[MEM_PAGE_NUM(addr)].gen : 0;
+}
+
+/*
+ *  ===== MemRestoreDirty =====
+ *      Rewind to a checkpoint taken with MemSaveImage + MemClearDirty by
+ *  copying back only the pages dirtied since.  Clears the dirty bits.
+ */
+void MemRestoreDirty(const NANO_SHORT* image)
+{
+	int n;
+	MEM_INIT();
+	for (n = 0; n < MEM_PAGES; ++n)
+	{
+		NANO_PAGE* page = &memPage[n];
+		if ((page->flags & MEM_DIRTY) == 0)
+			continue;
+		if (page->ram != NULL && (page->flags & MEM_ROM) == 0)
+		{
+			memcpy(page->ram, image + n * MEM_PAGE_WORDS, MEM_PAGE_SIZE);
+			MemPageReplaced(page);
+		}
+		page->flags &= ~MEM_DIRTY;
+	}
+}
+
+/* Fletcher-32 checksum of RAM/ROM pages */
+unsigned long MemChecksum(void)
+{
+	unsigned long sum1 = 0xFFFF, sum2 = 0xFFFF;
+	int n, i;
+	MEM_INIT();
+	for (n = 0; n < MEM_PAGES; ++n)
+	{
+		const NANO_SHORT* words = memPage[n].ram;
+		if (words == NULL)
+			continue;
+		/* MEM_PAGE_WORDS (128) sums cannot overflow 32 bits */
+		for (i = 0; i < MEM_PAGE_WORDS; ++i)
+		{
+			sum1 += words[i];
+			sum2 += sum1;
+		}
+		sum1 = (sum1 & 0xFFFF) + (sum1 >> 16);
+		sum2 = (sum2 & 0xFFFF) + (sum2 >> 16);
+	}
+	sum1 = (sum1 & 0xFFFF) + (sum1 >> 16);
+	sum2 = (sum2 & 0xFFFF) + (sum2 >> 16);
+	return (sum2 << 16) | sum1;
+}
@@ -0,0 +1,250 @@
+/* nanomem.h */
+
+#ifndef __NANOMEM_H__
+#define __NANOMEM_H__
+
+#include <stddef.h>
+#include "NanoCpu.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifdef _MSC_VER
+#define NANO_INLINE		__inline
+#else
+#define NANO_INLINE		inline
+#endif
+
+/*
+ *  Memory Bus
+ *
+ *  The 64K byte address space is divided into 256 byte pages.  Each page
+ *  entry holds direct host pointers for RAM/ROM reads & writes, or a
+ *  device whose handlers are called for every access.  A NULL host
+ *  pointer sends the access down the slow path (MemReadWord etc.), so
+ *  engines can inline RAM accesses as a table lookup plus a load.
+ */
+
+#define MEM_SIZE		(NANO_MEM_WORDS * 2)
+#define MEM_PAGE_SHIFT	8
+#define MEM_PAGE_SIZE	(1 << MEM_PAGE_SHIFT)		/* 256 bytes */
+#define MEM_PAGE_WORDS	(MEM_PAGE_SIZE / 2)
+#define MEM_PAGES		(MEM_SIZE / MEM_PAGE_SIZE)
+
+#define MEM_IO_BASE		0xC000						/* I/O window */
+#define MEM_UNMAPPED	0xDEAD						/* read from unmapped I/O or on a bus error */
+
+#define MEM_PAGE_NUM(a)	((a) >> MEM_PAGE_SHIFT)
+#define MEM_PAGE_IDX(a)	(((a) & (MEM_PAGE_SIZE - 1)) >> 1)
+
+/* non-zero unless addr is an even address within the page table */
+#define MEM_SLOW_ADDR(a)	((a) & ~(NANO_ADDR) (MEM_SIZE - 2))
+
+/*
+ *  Memory mapped device.  Handlers return the number of cycles taken or
+ *  a negative value for a bus error.  Byte loads call read with the
+ *  (possibly odd) byte address and take their byte from the word
+ *  returned.  Byte stores call write with the (possibly odd) byte address
+ *  and the byte in the low 8 bits of data.  The optional fifo handler
+ *  takes count successive byte stores to one register (e.g. a transmit
+ *  FIFO) in a single call; without it they are passed to write in turn.
+ */
+typedef struct nano_device
+{
+	const char* name;
+	int (*read)(void* ctx, NANO_ADDR addr, NANO_SHORT* data);
+	int (*write)(void* ctx, NANO_ADDR addr, NANO_SHORT data);
+	void* ctx;
+	int (*fifo)(void* ctx, NANO_ADDR addr, const unsigned char* data, NANO_ADDR count);
+} NANO_DEVICE;
+
+#define MEM_RAM			0x0001		/* page backed by host words */
+#define MEM_ROM			0x0002		/* writes are ignored */
+#define MEM_DIRTY		0x0004		/* written since MemClearDirty */
+#define MEM_CODE		0x0008		/* instructions fetched from page */
+
+typedef struct
+{
+	NANO_SHORT* rd;				/* host words for reads (NULL = slow path) */
+	NANO_SHORT* wr;				/* host words for writes (NULL = slow path) */
+	NANO_SHORT* ex;				/* host words for fetches (NULL = slow path) */
+	NANO_SHORT* ram;			/* backing host words (NULL for device) */
+	const NANO_DEVICE* dev;		/* device handlers (NULL for RAM/ROM) */
+	int flags;
+	unsigned long gen;			/* write generation, bumped on every store */
+} NANO_PAGE;
+
+extern NANO_PAGE memPage[MEM_PAGES];
+
+void MemInitMap(void);
+void MemMapRam(NANO_ADDR addr, NANO_ADDR size, NANO_SHORT* words);
+void MemMapRom(NANO_ADDR addr, NANO_ADDR size, NANO_SHORT* words);
+void MemMapDevice(NANO_ADDR addr, NANO_ADDR size, const NANO_DEVICE* dev);
+void MemUnmap(NANO_ADDR addr, NANO_ADDR size);
+void MemSavePages(NANO_ADDR addr, NANO_ADDR size, NANO_PAGE* saved);
+void MemRestorePages(NANO_ADDR addr, NANO_ADDR size, const NANO_PAGE* saved);
+int MemWriteFifo(NANO_ADDR addr, const unsigned char* data, NANO_ADDR count);
+
+/*
+ *  Dirty page tracking.  Every store to a RAM page sets MEM_DIRTY and
+ *  bumps the page generation, as does remapping a page.  A single owner
+ *  (e.g. checkpointing) can scan and clear dirty bits; any number of
+ *  consumers can instead remember generations and compare them later.
+ */
+#define MEM_PAGE_DIRTY(n)	((n)->flags |= MEM_DIRTY, ++(n)->gen)
+
+int MemIsDirty(NANO_ADDR addr, NANO_ADDR size);
+NANO_ADDR MemFindDirty(NANO_ADDR addr, NANO_ADDR* end);
+void MemClearDirty(NANO_ADDR addr, NANO_ADDR size);
+unsigned long MemPageGen(NANO_ADDR addr);
+void MemRestoreDirty(const NANO_SHORT* image);
+
+/*
+ *  Code pages.  The first fetch from a RAM page marks it MEM_CODE and
+ *  enables its ex pointer; from then on stores to it take the slow path,
+ *  which notifies code watchers of the words changed so they can drop
+ *  decoded or disassembled views of them.  Stores to data pages keep
+ *  the inline path and cost nothing extra.
+ */
+typedef void (*NANO_CODE_WATCH)(void* ctx, NANO_ADDR addr, NANO_ADDR size);
+
+#define MEM_MAX_WATCH	8
+
+int MemAddCodeWatch(NANO_CODE_WATCH watch, void* ctx);
+void MemRemoveCodeWatch(NANO_CODE_WATCH watch, void* ctx);
+int MemFetchWord(NANO_ADDR addr, NANO_SHORT* data);
+int MemReadByte(NANO_ADDR addr, NANO_SHORT* data);
+void MemClearCode(NANO_ADDR addr, NANO_ADDR size);
+
+/*
+ *  File backed regions (NanoMap.c).  Image files hold host order words,
+ *  the same layout as a .bin file.  ROM mappings are read-only and shared
+ *  so the page cache holds one copy for every running simulator; RAM
+ *  mappings are private copy-on-write unless MEM_MAP_PERSIST is given, in
+ *  which case stores are written back to the file.  Regions stop at the
+ *  I/O window (MEM_IO_BASE) so they never cover devices.
+ */
+#define MEM_MAP_ROM		0x0000
+#define MEM_MAP_RAM		0x0001
+#define MEM_MAP_PERSIST	0x0002
+
+#define MEM_MAX_MAPS	8
+
+int MemMapFile(NANO_ADDR addr, NANO_ADDR size, const char* path, int flags);
+void MemUnmapFile(NANO_ADDR addr);
+void MemUnmapFiles(void);
+const char* MemViewFile(const char* path, size_t* length);
+void MemReleaseView(const char* view, size_t length);
+
+/*
+ *  Far addresses (at or above MEM_SIZE, 32-bit core only) bypass the page
+ *  table.  An MMU may install memFarMap to translate them to host words;
+ *  it returns NULL for a bus error.  Far memory is not dirty or code
+ *  tracked.  Loads that end in a bus error return a negative value and
+ *  read MEM_UNMAPPED, like unmapped I/O.
+ */
+typedef NANO_SHORT* (*NANO_FAR_MAP)(NANO_ADDR addr);
+
+extern NANO_FAR_MAP memFarMap;
+
+/* Bus trace hook: slow path loads and stores (kind MEM_TRACE_xxx) */
+#define MEM_TRACE_READ		0
+#define MEM_TRACE_WRITE		1
+#define MEM_TRACE_BYTE		2
+
+typedef void (*NANO_BUS_TRACE)(NANO_ADDR addr, NANO_SHORT data, int kind);
+
+extern NANO_BUS_TRACE memTrace;
+
+void MemSetTrace(NANO_BUS_TRACE trace);
+void MemSetSlow(int on);
+
+/*
+ *  Access heatmap.  While on, every slow path load, store and opcode
+ *  fetch is counted per MEM_HEAT_SIZE byte block; like the bus trace it
+ *  sends all pages down the slow path, so it costs nothing while off.
+ *  The counters are only written by the thread running the CPU and may
+ *  be read from any other without locking.
+ */
+#define MEM_HEAT_SHIFT		6
+#define MEM_HEAT_SIZE		(1 << MEM_HEAT_SHIFT)
+#define MEM_HEAT_BLOCKS		(MEM_SIZE >> MEM_HEAT_SHIFT)
+
+#define MEM_HEAT_READ		0
+#define MEM_HEAT_WRITE		1
+#define MEM_HEAT_EXEC		2
+#define MEM_HEAT_KINDS		3
+
+extern unsigned long (*memHeat)[MEM_HEAT_BLOCKS];		/* NULL while off */
+
+void MemSetHeat(int on);
+const volatile unsigned long* MemHeatCounts(int kind);
+
+/* Read word: inline RAM access, else slow path */
+static NANO_INLINE int MemFastReadWord(NANO_ADDR addr, NANO_SHORT* data)
+{
+	if (!MEM_SLOW_ADDR(addr))
+	{
+		const NANO_SHORT* rd = memPage[MEM_PAGE_NUM(addr)].rd;
+		if (rd != NULL)
+		{
+			*data = rd[MEM_PAGE_IDX(addr)];
+			return 1;
+		}
+	}
+	return MemReadWord(addr, data);
+}
+
+/* Fetch opcode: inline code page access, else slow path marks page */
+static NANO_INLINE int MemFastFetchWord(NANO_ADDR addr, NANO_SHORT* data)
+{
+	if (!MEM_SLOW_ADDR(addr))
+	{
+		const NANO_SHORT* ex = memPage[MEM_PAGE_NUM(addr)].ex;
+		if (ex != NULL)
+		{
+			*data = ex[MEM_PAGE_IDX(addr)];
+			return 1;
+		}
+	}
+	return MemFetchWord(addr, data);
+}
+
+/* Read word holding byte addr: inline RAM access, else slow path */
+static NANO_INLINE int MemFastReadByte(NANO_ADDR addr, NANO_SHORT* data)
+{
+	if (addr < MEM_SIZE)
+	{
+		const NANO_SHORT* rd = memPage[MEM_PAGE_NUM(addr)].rd;
+		if (rd != NULL)
+		{
+			*data = rd[MEM_PAGE_IDX(addr)];
+			return 1;
+		}
+	}
+	return MemReadByte(addr, data);
+}
+
+/* Write word: inline RAM access, else slow path */
+static NANO_INLINE int MemFastWriteWord(NANO_ADDR addr, NANO_SHORT data)
+{
+	if (!MEM_SLOW_ADDR(addr))
+	{
+		NANO_PAGE* page = &memPage[MEM_PAGE_NUM(addr)];
+		if (page->wr != NULL)
+		{
+			page->wr[MEM_PAGE_IDX(addr)] = data;
+			MEM_PAGE_DIRTY(page);
+			return 1;
+		}
+	}
+	return MemWriteWord(addr, data);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOMEM_H__ */
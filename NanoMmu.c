@@ -0,0 +1,235 @@
+#include "NanoMmu.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DIR_SHIFT		8
+#define DIR_SIZE		(MMU_FRAMES >> DIR_SHIFT)
+#define DIR_MASK		((1 << DIR_SHIFT) - 1)
+
+#define FRAME_PAGES		(MMU_FRAME_SIZE / MEM_PAGE_SIZE)
+#define FRAME_WORDS		(MMU_FRAME_SIZE / 2)
+
+typedef struct
+{
+	NANO_ADDR tag;				/* far page number (addr >> MEM_PAGE_SHIFT) */
+	NANO_SHORT* words;			/* host words of page (NULL = invalid) */
+} MMU_TLB;
+
+/* Two level frame directory: dir[frame >> 8][frame & 0xFF] */
+static NANO_SHORT** mmuDir[DIR_SIZE];
+static MMU_TLB mmuTlb[MMU_TLB_SIZE];
+static NANO_SHORT mmuBank[MMU_SEGMENTS];
+static NANO_SHORT mmuCtrl = 0;
+static NANO_PAGE mmuSaved[MMU_SEGMENTS * FRAME_PAGES];	/* page table before enable */
+static char mmuAlias[MMU_SEGMENTS];		/* identity frame is RAM it was enabled over */
+
+/* Directory entry of frame (NULL if out of range or out of memory) */
+static NANO_SHORT** MmuSlot(NANO_ADDR frame)
+{
+	NANO_SHORT** table;
+	if (frame >= MMU_FRAMES)
+		return NULL;
+	table = mmuDir[frame >> DIR_SHIFT];
+	if (table == NULL)
+	{
+		table = (NANO_SHORT**) calloc(DIR_MASK + 1, sizeof(NANO_SHORT*));
+		if (table == NULL)
+			return NULL;
+		mmuDir[frame >> DIR_SHIFT] = table;
+	}
+	return &table[frame & DIR_MASK];
+}
+
+/* Host words of frame, allocated (zeroed) on first use */
+static NANO_SHORT* MmuFrame(NANO_ADDR frame)
+{
+	NANO_SHORT** slot = MmuSlot(frame);
+	if (slot == NULL)
+		return NULL;
+	if (*slot == NULL)
+		*slot = (NANO_SHORT*) calloc(FRAME_WORDS, sizeof(NANO_SHORT));
+	return *slot;
+}
+
+/*
+ *  ===== MmuIdentityFrame =====
+ *      Make frame segment hold what the segment held when the MMU was
+ *  enabled.  Contiguous writable RAM (the flat RAM or a RAM file mapping)
+ *  is aliased in place, so stores through either view reach the same
+ *  words; anything else (ROM, devices, split regions) is copied.
+ */
+static void MmuIdentityFrame(int segment)
+{
+	const NANO_PAGE* saved = &mmuSaved[segment * FRAME_PAGES];
+	NANO_SHORT** slot = MmuSlot(segment);
+	int i;
+
+	if (slot == NULL)
+		return;
+	for (i = 0; i < FRAME_PAGES; ++i)
+	{
+		if (saved[i].ram == NULL || (saved[i].flags & MEM_ROM) ||
+			saved[i].ram != saved[0].ram + i * MEM_PAGE_WORDS)
+			break;
+	}
+	if (!mmuAlias[segment])
+		free(*slot);
+	mmuAlias[segment] = (i == FRAME_PAGES);
+	if (mmuAlias[segment])
+	{
+		*slot = saved[0].ram;
+		return;
+	}
+	*slot = (NANO_SHORT*) calloc(FRAME_WORDS, sizeof(NANO_SHORT));
+	if (*slot == NULL)
+		return;
+	for (i = 0; i < FRAME_PAGES; ++i)
+	{
+		if (saved[i].ram != NULL)
+			memcpy(*slot + i * MEM_PAGE_WORDS, saved[i].ram, MEM_PAGE_SIZE);
+	}
+}
+
+static void MmuFlushTlb(void)
+{
+	memset(mmuTlb, 0, sizeof(mmuTlb));
+}
+
+/*
+ *  ===== MmuFarMap =====
+ *      Translate a far address: TLB hit costs one compare, a miss walks
+ *  the frame directory and refills the entry.
+ */
+static NANO_SHORT* MmuFarMap(NANO_ADDR addr)
+{
+	NANO_ADDR page = addr >> MEM_PAGE_SHIFT;
+	MMU_TLB* tlb = &mmuTlb[page & (MMU_TLB_SIZE - 1)];
+
+	if (tlb->tag != page || tlb->words == NULL)
+	{
+		NANO_SHORT* frame;
+		if ((mmuCtrl & MMU_ENABLE) == 0)
+			return NULL;
+		frame = MmuFrame(addr >> MMU_FRAME_SHIFT);
+		if (frame == NULL)
+			return NULL;
+		tlb->tag = page;
+		tlb->words = frame + (page % FRAME_PAGES) * MEM_PAGE_WORDS;
+	}
+	return &tlb->words[MEM_PAGE_IDX(addr)];
+}
+
+/*
+ *  Point the page table entries of segment at its bank frame.  A segment
+ *  banked onto its own frame gets back exactly what was mapped there
+ *  before, ROM and devices included.
+ */
+static void MmuMapSegment(int segment)
+{
+	NANO_ADDR addr = (NANO_ADDR) segment << MMU_FRAME_SHIFT;
+	NANO_SHORT* frame;
+
+	if (mmuBank[segment] == segment)
+	{
+		MemRestorePages(addr, MMU_FRAME_SIZE, &mmuSaved[segment * FRAME_PAGES]);
+		return;
+	}
+	frame = MmuFrame(mmuBank[segment]);
+	if (frame != NULL)
+		MemMapRam(addr, MMU_FRAME_SIZE, frame);
+	else
+		MemUnmap(addr, MMU_FRAME_SIZE);
+}
+
+void MmuSetBank(int segment, NANO_SHORT frame)
+{
+	if (segment < 0 || segment >= MMU_SEGMENTS)
+		return;
+	mmuBank[segment] = frame;
+	if (mmuCtrl & MMU_ENABLE)
+		MmuMapSegment(segment);
+}
+
+void MmuEnable(int enable)
+{
+	int n;
+	if (enable)
+	{
+		if ((mmuCtrl & MMU_ENABLE) == 0)
+		{
+			MemSavePages(0, MEM_IO_BASE, mmuSaved);
+			for (n = 0; n < MMU_SEGMENTS; ++n)
+				MmuIdentityFrame(n);
+		}
+		mmuCtrl |= MMU_ENABLE;
+		for (n = 0; n < MMU_SEGMENTS; ++n)
+			MmuMapSegment(n);
+	}
+	else if (mmuCtrl & MMU_ENABLE)
+	{
+		mmuCtrl &= ~MMU_ENABLE;
+		MemRestorePages(0, MEM_IO_BASE, mmuSaved);
+	}
+	MmuFlushTlb();
+}
+
+static int MmuRead(void* ctx, NANO_ADDR addr, NANO_SHORT* data)
+{
+	int n = (addr - MMU_BASE) >> 1;
+	if (n < MMU_SEGMENTS)
+		*data = mmuBank[n];
+	else if ((addr & ~1) == MMU_CTRL)
+		*data = mmuCtrl;
+	else
+		*data = 0;
+	return 1;
+}
+
+static int MmuWrite(void* ctx, NANO_ADDR addr, NANO_SHORT data)
+{
+	int n = (addr - MMU_BASE) >> 1;
+	if (n < MMU_SEGMENTS)
+		MmuSetBank(n, data);
+	else if ((addr & ~1) == MMU_CTRL)
+		MmuEnable(data & MMU_ENABLE);
+	return 1;
+}
+
+static const NANO_DEVICE mmuDevice =
+{
+	"mmu", MmuRead, MmuWrite, NULL
+};
+
+/* Install the MMU registers; banks reset to the identity mapping */
+int MmuInit(void)
+{
+	int n;
+	for (n = 0; n < MMU_SEGMENTS; ++n)
+		mmuBank[n] = (NANO_SHORT) n;
+	mmuCtrl = 0;
+	MmuFlushTlb();
+	MemMapDevice(MMU_BASE, MEM_PAGE_SIZE, &mmuDevice);
+	memFarMap = MmuFarMap;
+	return 0;
+}
+
+void MmuFree(void)
+{
+	int i, j;
+	MmuEnable(0);
+	memFarMap = NULL;
+	MemUnmap(MMU_BASE, MEM_PAGE_SIZE);
+	for (i = 0; i < DIR_SIZE; ++i)
+	{
+		if (mmuDir[i] == NULL)
+			continue;
+		for (j = 0; j <= DIR_MASK; ++j)
+		{
+			if (i != 0 || j >= MMU_SEGMENTS || !mmuAlias[j])
+				free(mmuDir[i][j]);
+		}
+		free(mmuDir[i]);
+		mmuDir[i] = NULL;
+	}
+	memset(mmuAlias, 0, sizeof(mmuAlias));
+}
@@ -0,0 +1,63 @@
+/* nanommu.h */
+
+#ifndef __NANOMMU_H__
+#define __NANOMMU_H__
+
+#include "NanoMem.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *  Banked MMU
+ *
+ *  The host backing store is a sparse array of 4K byte frames (up to 64K
+ *  frames = 256M bytes), allocated on first use.  While enabled:
+ *
+ *  - Each 4K segment of the 48K RAM area below the I/O window is mapped
+ *    onto the frame in its bank register.  Writing a bank register points
+ *    the segment's 16 page table entries at the frame, so banked accesses
+ *    run at the speed of flat RAM.
+ *  - Far addresses of the 32-bit core (0x10000 and up) map linearly onto
+ *    frame (addr >> 12) through a small direct mapped software TLB.
+ *
+ *  Frames are shared: frame 0x123 is both far address 0x123000 and
+ *  whatever segment has 0x123 in its bank register.
+ *
+ *  Banks reset to the identity mapping, under which enabling the MMU
+ *  changes nothing: frames 0 to MMU_SEGMENTS-1 are taken from the
+ *  segments each time it is enabled (RAM aliased in place, anything else
+ *  copied), a segment banked onto its own frame keeps what was mapped
+ *  there, and disabling puts back the page table as it was, file
+ *  mappings included.
+ *
+ *  Frames not currently banked into a segment are outside the page
+ *  table, so memory images (MemSaveImage), MemChecksum and hence the
+ *  verifier and the co-simulation bridge do not see them.
+ */
+
+#define MMU_BASE		0xFC00
+#define MMU_BANK(n)		(MMU_BASE + 2 * (n))	/* frame of segment n */
+#define MMU_CTRL		(MMU_BASE + 0x20)		/* control register */
+
+#define MMU_ENABLE		0x0001					/* CTRL: translation on */
+
+#define MMU_SEGMENTS	(MEM_IO_BASE >> MMU_FRAME_SHIFT)
+#define MMU_FRAME_SHIFT	12
+#define MMU_FRAME_SIZE	(1 << MMU_FRAME_SHIFT)
+#define MMU_FRAMES		0x10000
+
+#define MMU_TLB_SIZE	64						/* power of 2 */
+
+int MmuInit(void);
+void MmuFree(void);
+void MmuEnable(int enable);
+void MmuSetBank(int segment, NANO_SHORT frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOMMU_H__ */
@@ -0,0 +1,121 @@
+#include <string.h>
+#include "NanoPace.h"
+
+void PaceInit(NANO_PACE* pace, unsigned long hz)
+{
+	memset(pace, 0, sizeof(*pace));
+	pace->hz = hz;
+	pace->slice = PACE_MIN_SLICE;		/* grows once a slice is measured */
+	pace->startUs = NanoTimeUs();
+}
+
+/* Anchor the CPU's cycles to the wall clock now; again after any reset */
+void PaceStart(NANO_PACE* pace, const NANO_CPU* p)
+{
+	pace->anchorCycles = p->cycles;
+	pace->anchorUs = NanoTimeUs();
+}
+
+/* Wall clock time at which the CPU's current cycle is due */
+static NANO_USEC PaceDue(NANO_PACE* pace, const NANO_CPU* p)
+{
+	NANO_TIME elapsed = p->cycles - pace->anchorCycles;
+	NANO_TIME seconds = elapsed / pace->hz;
+
+	/* move the anchor in whole seconds so NANO_TIME cannot wrap */
+	pace->anchorCycles += seconds * pace->hz;
+	pace->anchorUs += (NANO_USEC) seconds * 1000000;
+	elapsed -= seconds * pace->hz;
+	return pace->anchorUs + (NANO_USEC) elapsed * 1000000 / pace->hz;
+}
+
+/*
+ *  ===== PaceWait =====
+ *      Sleep until the CPU's next cycle is due, but for no more than
+ *  maxUs.  Returns 0 when it is due, else the microseconds still to wait.
+ *  A deadline closer than the usual oversleep counts as due.
+ */
+long PaceWait(NANO_PACE* pace, const NANO_CPU* p, long maxUs)
+{
+	NANO_USEC due = PaceDue(pace, p);
+	NANO_USEC now = NanoTimeUs();
+	long sleep, slept;
+
+	if (now >= due)
+	{
+		if (now - due > PACE_RESYNC_US)
+		{
+			PaceStart(pace, p);
+			++pace->resyncs;
+		}
+		else if ((long) (now - due) > pace->maxLateUs)
+		{
+			pace->maxLateUs = (long) (now - due);
+		}
+		return 0;
+	}
+	if (due - now <= (NANO_USEC) pace->oversleepUs)
+		return 0;
+	sleep = (due - now > (NANO_USEC) maxUs) ? maxUs : (long) (due - now) - pace->oversleepUs;
+	NanoSleepUs(sleep);
+	slept = (long) (NanoTimeUs() - now);
+	pace->oversleepUs += (slept - sleep - pace->oversleepUs) / 8;
+	if (pace->oversleepUs < 0)
+		pace->oversleepUs = 0;
+	now += slept;
+	return (now + pace->oversleepUs >= due) ? 0 : (long) (due - now);
+}
+
+/* Size the next slice to PACE_SLICE_US of target time at the measured rate */
+static void PaceAdapt(NANO_PACE* pace, NANO_TIME cycles, long count)
+{
+	NANO_USEC target = (NANO_USEC) pace->hz * PACE_SLICE_US / 1000000;
+	NANO_USEC slice;
+	if (cycles == 0 || count == 0)
+		return;
+	slice = target * count / cycles;
+	slice = (slice + pace->slice) / 2;
+	if (slice < PACE_MIN_SLICE)
+		slice = PACE_MIN_SLICE;
+	else if (slice > PACE_MAX_SLICE)
+		slice = PACE_MAX_SLICE;
+	pace->slice = (long) slice;
+}
+
+/*
+ *  ===== PaceRun =====
+ *      Run count instructions in paced slices.  Like RunInst, returns
+ *  fewer than count only when the breakpoint was reached.
+ */
+long PaceRun(NANO_PACE* pace, const NANO_CORE* core, NANO_CPU* p, long count)
+{
+	long n = 0;
+	while (n < count)
+	{
+		long want = (count - n < pace->slice) ? count - n : pace->slice;
+		NANO_TIME start = p->cycles;
+		long done;
+
+		while (PaceWait(pace, p, PACE_RESYNC_US) > 0)
+			;
+		done = core->RunInst(p, want);
+		n += done;
+		pace->cycles += p->cycles - start;
+		++pace->slices;
+		PaceAdapt(pace, p->cycles - start, done);
+		if (done < want)
+			break;
+	}
+	return n;
+}
+
+void PaceReport(const NANO_PACE* pace, FILE* fp)
+{
+	NANO_USEC us = NanoTimeUs() - pace->startUs;
+	fprintf(fp, "paced %lu cycles in %lu.%03lu s (%.3f MHz, target %.3f MHz)\n",
+		(unsigned long) pace->cycles, (unsigned long) (us / 1000000),
+		(unsigned long) (us % 1000000 / 1000),
+		us ? (double) pace->cycles / us : 0.0, pace->hz / 1e6);
+	fprintf(fp, "%lu slices of %ld, worst start %ld us late, %lu resyncs\n",
+		pace->slices, pace->slice, pace->maxLateUs, pace->resyncs);
+}
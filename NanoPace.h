@@ -0,0 +1,62 @@
+/* nanopace.h */
+
+#ifndef __NANOPACE_H__
+#define __NANOPACE_H__
+
+#include <stdio.h>
+#include "NanoCpu.h"
+#include "NanoThread.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *  Real time pacing
+ *
+ *  Runs the CPU so that cycles advance at a target clock rate rather than
+ *  as fast as the host allows.  Execution proceeds in slices sized to
+ *  cover about PACE_SLICE_US of target time at the cycles per instruction
+ *  measured so far, and the host sleeps until each slice is due.  Sleeps
+ *  are shortened by the oversleep the host has shown, so wake-ups land
+ *  close to the deadline without spinning.
+ *
+ *  The CPU's cycle count is anchored to the wall clock when pacing starts.
+ *  If the host falls more than PACE_RESYNC_US behind (a debugger stop, an
+ *  overloaded machine) the anchor moves rather than the CPU racing to
+ *  catch up.  Idle loops skipped by the scheduler advance cycles at once,
+ *  so a firmware waiting for a timer costs a sleep, not a core.
+ */
+
+#define PACE_SLICE_US		1000		/* target time per slice */
+#define PACE_RESYNC_US		100000		/* lag after which the anchor moves */
+#define PACE_MIN_SLICE		16			/* instructions */
+#define PACE_MAX_SLICE		100000
+
+typedef struct
+{
+	unsigned long hz;			/* target clock, cycles per second */
+	NANO_TIME anchorCycles;		/* cycles at anchorUs */
+	NANO_USEC anchorUs;
+	long slice;					/* instructions per slice */
+	long oversleepUs;			/* average sleep overshoot */
+
+	NANO_USEC startUs;			/* statistics */
+	NANO_TIME cycles;			/* run by PaceRun */
+	unsigned long slices;
+	unsigned long resyncs;
+	long maxLateUs;				/* worst slice start after its deadline */
+} NANO_PACE;
+
+void PaceInit(NANO_PACE* pace, unsigned long hz);
+void PaceStart(NANO_PACE* pace, const NANO_CPU* p);
+long PaceWait(NANO_PACE* pace, const NANO_CPU* p, long maxUs);
+long PaceRun(NANO_PACE* pace, const NANO_CORE* core, NANO_CPU* p, long count);
+void PaceReport(const NANO_PACE* pace, FILE* fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOPACE_H__ */
@@ -0,0 +1,283 @@
+#include <stdlib.h>
+#include <string.h>
+#include "NanoPlugin.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#define PLUGIN_OPEN(path)		((void*) LoadLibraryA(path))
+#define PLUGIN_SYM(lib, name)	((void*) GetProcAddress((HMODULE) (lib), name))
+#define PLUGIN_CLOSE(lib)		FreeLibrary((HMODULE) (lib))
+#else
+#include <dlfcn.h>
+#define PLUGIN_OPEN(path)		dlopen(path, RTLD_NOW | RTLD_LOCAL)
+#define PLUGIN_SYM(lib, name)	dlsym(lib, name)
+#define PLUGIN_CLOSE(lib)		dlclose(lib)
+#endif
+
+typedef struct
+{
+	void* lib;					/* shared object handle */
+	const NANO_PLUGIN* plugin;
+	NANO_PAGE* saved;			/* page table entries its ranges replaced */
+} NANO_LOADED;
+
+static NANO_LOADED pluginList[PLUGIN_MAX];
+static int pluginCount = 0;
+
+/* Events plugins have scheduled, cancelled before their code is unloaded */
+static NANO_EVENT** pluginEvents = NULL;
+static int pluginEventCount = 0;
+static int pluginEventMax = 0;
+
+static void PluginSchedule(NANO_EVENT* ev, NANO_TIME when)
+{
+	int i;
+	for (i = 0; i < pluginEventCount; ++i)
+	{
+		if (pluginEvents[i] == ev)
+			break;
+	}
+	if (i == pluginEventCount)
+	{
+		if (pluginEventCount == pluginEventMax)
+		{
+			int want = (pluginEventMax > 0) ? pluginEventMax * 2 : 16;
+			NANO_EVENT** grown = (NANO_EVENT**) realloc(pluginEvents, want * sizeof(NANO_EVENT*));
+			if (grown == NULL)
+				return;				/* an event we could not cancel is not run */
+			pluginEvents = grown;
+			pluginEventMax = want;
+		}
+		pluginEvents[pluginEventCount++] = ev;
+	}
+	SchedAdd(ev, when);
+}
+
+static const NANO_HOST pluginHost =
+{
+	NANO_PLUGIN_VERSION,
+	SchedTime,
+	PluginSchedule,
+	SchedCancel,
+	MemReadWord,
+	MemWriteWord
+};
+
+/* Shared objects, for plugins and other loadable models */
+void* NanoLibOpen(const char* path)
+{
+	return PLUGIN_OPEN(path);
+}
+
+void* NanoLibSymbol(void* lib, const char* name)
+{
+	return PLUGIN_SYM(lib, name);
+}
+
+void NanoLibClose(void* lib)
+{
+	PLUGIN_CLOSE(lib);
+}
+
+/* Ranges must be whole pages below the top of the page table */
+static int PluginCheck(const NANO_PLUGIN* plugin)
+{
+	int i;
+	if (plugin->version != NANO_PLUGIN_VERSION || plugin->device.read == NULL ||
+		plugin->device.write == NULL || plugin->nranges <= 0)
+		return -1;
+	for (i = 0; i < plugin->nranges; ++i)
+	{
+		const NANO_RANGE* range = &plugin->ranges[i];
+		if (((range->addr | range->size) & (MEM_PAGE_SIZE - 1)) != 0 ||
+			range->size == 0 || range->addr + range->size > MEM_SIZE)
+			return -1;
+	}
+	return 0;
+}
+
+/*
+ *  ===== PluginLoad =====
+ *      Load the plugin at path and map its ranges over whatever was there,
+ *  which is put back when it is unloaded.  Returns 0, or -1 if it cannot
+ *  be loaded or is not a compatible plugin.
+ */
+int PluginLoad(const char* path)
+{
+	NANO_PLUGIN_INIT init;
+	const NANO_PLUGIN* plugin;
+	NANO_PAGE* saved;
+	NANO_ADDR pages = 0;
+	void* lib;
+	int i;
+
+	if (pluginCount == PLUGIN_MAX)
+		return -1;
+	lib = PLUGIN_OPEN(path);
+	if (lib == NULL)
+		return -1;
+	init = (NANO_PLUGIN_INIT) PLUGIN_SYM(lib, NANO_PLUGIN_ENTRY);
+	plugin = (init != NULL) ? init(&pluginHost) : NULL;
+	if (plugin == NULL || PluginCheck(plugin) < 0)
+	{
+		if (plugin != NULL && plugin->close != NULL)
+			plugin->close(plugin->device.ctx);
+		PLUGIN_CLOSE(lib);
+		return -1;
+	}
+	for (i = 0; i < plugin->nranges; ++i)
+		pages += plugin->ranges[i].size >> MEM_PAGE_SHIFT;
+	saved = (NANO_PAGE*) malloc(pages * sizeof(NANO_PAGE));
+	if (saved == NULL)
+	{
+		if (plugin->close != NULL)
+			plugin->close(plugin->device.ctx);
+		PLUGIN_CLOSE(lib);
+		return -1;
+	}
+	pluginList[pluginCount].lib = lib;
+	pluginList[pluginCount].plugin = plugin;
+	pluginList[pluginCount].saved = saved;
+	++pluginCount;
+	for (i = 0; i < plugin->nranges; ++i)
+	{
+		MemSavePages(plugin->ranges[i].addr, plugin->ranges[i].size, saved);
+		MemMapDevice(plugin->ranges[i].addr, plugin->ranges[i].size, &plugin->device);
+		saved += plugin->ranges[i].size >> MEM_PAGE_SHIFT;
+	}
+	return 0;
+}
+
+/* Load each plugin of a NANO_PLUGIN_SEP separated list; returns the count */
+int PluginLoadList(const char* list)
+{
+	char path[1024];
+	int loaded = 0;
+
+	while (list != NULL && *list != '\0')
+	{
+		const char* end = strchr(list, NANO_PLUGIN_SEP);
+		size_t length = (end != NULL) ? (size_t) (end - list) : strlen(list);
+		if (length > 0 && length < sizeof(path))
+		{
+			memcpy(path, list, length);
+			path[length] = '\0';
+			if (PluginLoad(path) == 0)
+				++loaded;
+		}
+		list = (end != NULL) ? end + 1 : NULL;
+	}
+	return loaded;
+}
+
+int PluginLoadEnv(void)
+{
+	return PluginLoadList(getenv(NANO_PLUGIN_ENV));
+}
+
+/*
+ *  ===== PluginUnloadAll =====
+ *      Unload plugins, putting back the devices or memory their ranges
+ *  replaced.  Events they left scheduled are cancelled before they are
+ *  closed and their code goes away.
+ */
+void PluginUnloadAll(void)
+{
+	int n, i;
+
+	for (n = pluginCount; --n >= 0; )
+	{
+		const NANO_PLUGIN* plugin = pluginList[n].plugin;
+		NANO_PAGE* saved = pluginList[n].saved;
+		for (i = 0; i < plugin->nranges; ++i)
+			saved += plugin->ranges[i].size >> MEM_PAGE_SHIFT;
+		/* last loaded first, last range first, so overlaps unwind */
+		for (i = plugin->nranges; --i >= 0; )
+		{
+			saved -= plugin->ranges[i].size >> MEM_PAGE_SHIFT;
+			MemRestorePages(plugin->ranges[i].addr, plugin->ranges[i].size, saved);
+		}
+		free(pluginList[n].saved);
+	}
+	for (i = 0; i < pluginEventCount; ++i)
+		SchedCancel(pluginEvents[i]);
+	free(pluginEvents);
+	pluginEvents = NULL;
+	pluginEventCount = pluginEventMax = 0;
+	while (pluginCount > 0)
+	{
+		NANO_LOADED* loaded = &pluginList[--pluginCount];
+		if (loaded->plugin->close != NULL)
+			loaded->plugin->close(loaded->plugin->device.ctx);
+		PLUGIN_CLOSE(loaded->lib);
+	}
+}
+
+void PluginReset(void)
+{
+	int n;
+	for (n = 0; n < pluginCount; ++n)
+	{
+		const NANO_PLUGIN* plugin = pluginList[n].plugin;
+		if (plugin->reset != NULL)
+			plugin->reset(plugin->device.ctx);
+	}
+}
+
+/*
+ *  ===== PluginSave =====
+ *      Save the state of every plugin to buf as a length prefixed block
+ *  each.  Returns the bytes needed; nothing is written if that is more
+ *  than size (pass a NULL buf to ask).
+ */
+size_t PluginSave(void* buf, size_t size)
+{
+	unsigned char* ptr = (unsigned char*) buf;
+	size_t total = 0;
+	int n;
+
+	for (n = 0; n < pluginCount; ++n)
+	{
+		const NANO_PLUGIN* plugin = pluginList[n].plugin;
+		size_t length = (plugin->save != NULL) ? plugin->save(plugin->device.ctx, NULL, 0) : 0;
+		total += sizeof(size_t) + length;
+	}
+	if (buf == NULL || total > size)
+		return total;
+	for (n = 0; n < pluginCount; ++n)
+	{
+		const NANO_PLUGIN* plugin = pluginList[n].plugin;
+		size_t length = (plugin->save != NULL) ? plugin->save(plugin->device.ctx, NULL, 0) : 0;
+		memcpy(ptr, &length, sizeof(size_t));
+		ptr += sizeof(size_t);
+		if (length > 0)
+			plugin->save(plugin->device.ctx, ptr, length);
+		ptr += length;
+	}
+	return total;
+}
+
+/* Restore state saved by PluginSave with the same plugins loaded */
+int PluginRestore(const void* buf, size_t size)
+{
+	const unsigned char* ptr = (const unsigned char*) buf;
+	const unsigned char* end = ptr + size;
+	int n;
+
+	for (n = 0; n < pluginCount; ++n)
+	{
+		const NANO_PLUGIN* plugin = pluginList[n].plugin;
+		size_t length;
+		if ((size_t) (end - ptr) < sizeof(size_t))
+			return -1;
+		memcpy(&length, ptr, sizeof(size_t));
+		ptr += sizeof(size_t);
+		if ((size_t) (end - ptr) < length)
+			return -1;
+		if (length > 0 && (plugin->restore == NULL ||
+			plugin->restore(plugin->device.ctx, ptr, length) < 0))
+			return -1;
+		ptr += length;
+	}
+	return 0;
+}
@@ -0,0 +1,98 @@
+/* nanoplugin.h */
+
+#ifndef __NANOPLUGIN_H__
+#define __NANOPLUGIN_H__
+
+#include <stddef.h>
+#include "NanoMem.h"
+#include "NanoSched.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *  Peripheral plugins
+ *
+ *  A plugin is a shared object exporting NANO_PLUGIN_ENTRY.  At load time
+ *  it is handed the host services and returns a static description of
+ *  its device: the address ranges it claims (whole pages) and the usual
+ *  NANO_DEVICE handlers, which are installed in the page table exactly as
+ *  a built-in device's are, so an access costs the same.  Successive
+ *  byte stores to one register (e.g. DMA into a FIFO) arrive batched
+ *  through the device's fifo handler when it has one.
+ *
+ *  Plugins schedule their own events through the host and may save and
+ *  restore their state as an opaque block.  When plugins are unloaded
+ *  their pages get back what they replaced (memory or a built-in device)
+ *  and every event they scheduled is cancelled before close is called,
+ *  so close must not schedule any.  Any change to these structures
+ *  bumps NANO_PLUGIN_VERSION; mismatched plugins are refused.
+ *
+ *  NanoTick.c is an example plugin ("make plugins").
+ */
+
+#define NANO_PLUGIN_VERSION	1
+#define NANO_PLUGIN_ENTRY	"NanoPluginInit"
+#define NANO_PLUGIN_ENV		"NANOSIM_PLUGINS"
+
+#ifdef _WIN32
+#define NANO_PLUGIN_EXPORT	__declspec(dllexport)
+#define NANO_PLUGIN_SEP		';'
+#else
+#define NANO_PLUGIN_EXPORT
+#define NANO_PLUGIN_SEP		':'
+#endif
+
+#define PLUGIN_MAX			8
+
+typedef struct
+{
+	NANO_ADDR addr;				/* page aligned */
+	NANO_ADDR size;				/* bytes, whole pages */
+} NANO_RANGE;
+
+/* Services the simulator provides to plugins */
+typedef struct nano_host
+{
+	int version;
+	NANO_TIME (*Time)(void);
+	void (*Schedule)(NANO_EVENT* ev, NANO_TIME when);
+	void (*Cancel)(NANO_EVENT* ev);
+	int (*ReadWord)(NANO_ADDR addr, NANO_SHORT* data);
+	int (*WriteWord)(NANO_ADDR addr, NANO_SHORT data);
+} NANO_HOST;
+
+/* What a plugin provides; must stay valid until close is called */
+typedef struct nano_plugin
+{
+	int version;				/* NANO_PLUGIN_VERSION */
+	NANO_DEVICE device;
+	const NANO_RANGE* ranges;
+	int nranges;
+	void (*reset)(void* ctx);	/* optional */
+	size_t (*save)(void* ctx, void* buf, size_t size);			/* optional: bytes needed */
+	int (*restore)(void* ctx, const void* buf, size_t size);	/* optional */
+	void (*close)(void* ctx);	/* optional */
+} NANO_PLUGIN;
+
+typedef const NANO_PLUGIN* (*NANO_PLUGIN_INIT)(const NANO_HOST* host);
+
+void* NanoLibOpen(const char* path);
+void* NanoLibSymbol(void* lib, const char* name);
+void NanoLibClose(void* lib);
+
+int PluginLoad(const char* path);
+int PluginLoadList(const char* list);
+int PluginLoadEnv(void);
+void PluginUnloadAll(void);
+void PluginReset(void);
+size_t PluginSave(void* buf, size_t size);
+int PluginRestore(const void* buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOPLUGIN_H__ */
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "NanoMmu.h"
+#include "NanoDma.h"
+#include "NanoTimer.h"
+#include "NanoGpio.h"
+#include "NanoUart.h"
+#include "NanoPlugin.h"
+#include "NanoVcd.h"
+#include "NanoVerify.h"
+#include "NanoCosim.h"
+#include "NanoPace.h"
+#include "NanoLoad.h"
+
+#define NANO_RAM_WORDS	24576		// 24K x 16 (48K Bytes) of RAM
+
+
+// Headless Nano simulator for batch & regression runs
+static void Usage(void)
+{
+	fprintf(stderr,
+		"usage: NanoRun [options] image.bin|image.hex|image.s19\n"
+		"  -32            simulate the 32-bit core\n"
+		"  -m             install the banked MMU at FC00\n"
+		"  -n count       instructions to run (default 1000000)\n"
+		"  -v interval    verify fast engine every interval instructions\n"
+		"  -s sample      with -v, check only every Nth interval (default 1)\n"
+		"  -r addr file   map file read-only (shared ROM) at addr\n"
+		"  -w addr file   map file as RAM at addr, writing stores back to file\n"
+		"  -i source      UART input from - (stdin), pty, a file or a named pipe\n"
+		"  -p plugin      load a peripheral plugin (also $" NANO_PLUGIN_ENV ")\n"
+		"  -t file.vcd    record a waveform of GPIO, UART and PC\n"
+		"  -b             with -t, record bus loads & stores too\n"
+		"  -c model       co-simulate against an RTL model in lockstep\n"
+		"  -f mhz         run in real time at mhz MHz of Nano cycles\n");
+}
+
+int main(int argc, char* argv[])
+{
+	NANO_CPU cpu;
+	const NANO_CORE* core;
+	int bits = 16;
+	long count = 1000000;
+	long interval = 0;
+	long sample = 1;
+	const char* path = NULL;
+	const char* input = NULL;
+	const char* plugins[PLUGIN_MAX];
+	int nplugins = 0;
+	const char* vcd = NULL;
+	const char* model = NULL;
+	unsigned long hz = 0;
+	int vcdFlags = 0;
+	int result = 0;
+	int line;
+	int i;
+
+	for (i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-32") == 0)
+			bits = 32;
+		else if (strcmp(argv[i], "-m") == 0)
+			MmuInit();
+		else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+			count = atol(argv[++i]);
+		else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc)
+			interval = atol(argv[++i]);
+		else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+			input = argv[++i];
+		else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc && nplugins < PLUGIN_MAX)
+			plugins[nplugins++] = argv[++i];
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+			vcd = argv[++i];
+		else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+			model = argv[++i];
+		else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+			hz = (unsigned long) (atof(argv[++i]) * 1e6);
+		else if (strcmp(argv[i], "-b") == 0)
+			vcdFlags |= VCD_BUS;
+		else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+			sample = atol(argv[++i]);
+		else if ((strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "-w") == 0) && i + 2 < argc)
+		{
+			int flags = (argv[i][1] == 'w') ? MEM_MAP_RAM | MEM_MAP_PERSIST : MEM_MAP_ROM;
+			NANO_ADDR addr = (NANO_ADDR) strtoul(argv[i + 1], NULL, 16);
+			if (MemMapFile(addr, 0, argv[i + 2], flags) < 0)
+			{
+				fprintf(stderr, "%s: cannot map at %04X\n", argv[i + 2], addr);
+				return 1;
+			}
+			i += 2;
+		}
+		else if (argv[i][0] != '-' && path == NULL)
+			path = argv[i];
+		else
+		{
+			Usage();
+			return 2;
+		}
+	}
+	if (path == NULL)
+	{
+		Usage();
+		return 2;
+	}
+	GpioInit();
+	UartInit();
+	UartSetFd(1);
+	if (input != NULL && UartOpenInput(input) < 0)
+	{
+		fprintf(stderr, "%s: cannot open UART input\n", input);
+		return 1;
+	}
+	DmaInit();
+	TimerInit();
+	PluginLoadEnv();
+	for (i = 0; i < nplugins; ++i)
+	{
+		if (PluginLoad(plugins[i]) < 0)
+		{
+			fprintf(stderr, "%s: cannot load plugin\n", plugins[i]);
+			return 1;
+		}
+	}
+	result = LoadImage(path, NANO_RAM_WORDS * 2, &line);
+	if (result < 0)
+	{
+		if (line > 0)
+			fprintf(stderr, "%s:%d: %s\n", path, line, LoadError(result));
+		else
+			fprintf(stderr, "%s: %s\n", path, LoadError(result));
+		return 1;
+	}
+
+	if (vcd != NULL && VcdOpen(vcd, bits, vcdFlags) < 0)
+	{
+		fprintf(stderr, "%s: cannot create waveform\n", vcd);
+		return 1;
+	}
+
+	core = NanoGetCore(bits);
+	NanoResetCore(&cpu, bits);
+	cpu.breakpoint = 0xFFFF;
+	if (interval > 0)
+	{
+		NANO_VERIFY verify;
+		if (NanoVerifyInit(&verify, core->RunInst, interval, sample) < 0)
+		{
+			fprintf(stderr, "out of memory\n");
+			return 1;
+		}
+		NanoVerifyRun(&verify, &cpu, count);
+		UartFlush();
+		NanoVerifyReport(&verify, stderr);
+		result = verify.clockError ? 5 : verify.diverged ? 3 : 0;
+		NanoVerifyFree(&verify);
+	}
+	else if (model != NULL)
+	{
+		NANO_COSIM cosim;
+		if (NanoCosimInit(&cosim, model, &cpu) < 0)
+		{
+			fprintf(stderr, "%s: cannot load RTL model\n", model);
+			return 1;
+		}
+		NanoCosimRun(&cosim, &cpu, count);
+		UartFlush();
+		NanoCosimReport(&cosim, &cpu, stderr);
+		result = cosim.diverged ? 4 : 0;
+		NanoCosimFree(&cosim);
+	}
+	else if (hz != 0)
+	{
+		NANO_PACE pace;
+		PaceInit(&pace, hz);
+		PaceStart(&pace, &cpu);
+		PaceRun(&pace, core, &cpu, count);
+		UartFlush();
+		PaceReport(&pace, stderr);
+	}
+	else
+	{
+		core->RunInst(&cpu, count);
+	}
+	UartFlush();
+	UartCloseInput();
+	VcdClose();
+	PluginUnloadAll();
+	return result;
+}
@@ -0,0 +1,181 @@
+#include <stddef.h>
+#include "NanoSched.h"
+
+#define SLOT_MASK		(SCHED_SLOTS - 1)
+#define SLOT_OF(t)		(((t) >> SCHED_SLOT_SHIFT) & SLOT_MASK)
+
+static NANO_EVENT* schedWheel[SCHED_SLOTS];
+static volatile NANO_TIME* schedClock = NULL;
+static NANO_TIME schedLast = 0;		/* time when detached */
+
+int schedPending = 0;				/* events scheduled */
+NANO_TIME schedNext = 0;			/* earliest due time (if pending) */
+
+void SchedInit(void)
+{
+	int i;
+	for (i = 0; i < SCHED_SLOTS; ++i)
+		schedWheel[i] = NULL;
+	schedPending = 0;
+}
+
+/* Engines attach their cycle counter while running (NULL to detach) */
+void SchedAttach(volatile NANO_TIME* clock)
+{
+	if (schedClock != NULL)
+		schedLast = *schedClock;
+	schedClock = clock;
+}
+
+NANO_TIME SchedTime(void)
+{
+	return (schedClock != NULL) ? *schedClock : schedLast;
+}
+
+/* Earliest event time, scanning one turn of the wheel from time from */
+static void SchedFindNext(NANO_TIME from)
+{
+	NANO_TIME best = 0;
+	int found = 0;
+	int i;
+
+	if (schedPending == 0)
+		return;
+	for (i = 0; i < SCHED_SLOTS; ++i)
+	{
+		/* events in this slot due within this turn */
+		NANO_TIME start = (from & ~(NANO_TIME) (SCHED_SLOT_CYCLES - 1)) + ((NANO_TIME) i << SCHED_SLOT_SHIFT);
+		NANO_TIME end = start + SCHED_SLOT_CYCLES;
+		NANO_EVENT* ev;
+		for (ev = schedWheel[SLOT_OF(start)]; ev != NULL; ev = ev->next)
+		{
+			if (!found || (long) (ev->when - best) < 0)
+			{
+				best = ev->when;
+				found = 1;
+			}
+		}
+		if (found && (long) (best - end) < 0)
+			break;
+	}
+	schedNext = best;
+}
+
+void SchedAdd(NANO_EVENT* ev, NANO_TIME when)
+{
+	NANO_EVENT** slot;
+	if (ev->pending)
+		SchedCancel(ev);
+	slot = &schedWheel[SLOT_OF(when)];
+	ev->when = when;
+	ev->next = *slot;
+	ev->pending = 1;
+	*slot = ev;
+	if (schedPending++ == 0 || (long) (when - schedNext) < 0)
+		schedNext = when;
+}
+
+void SchedCancel(NANO_EVENT* ev)
+{
+	NANO_EVENT** link;
+	if (!ev->pending)
+		return;
+	for (link = &schedWheel[SLOT_OF(ev->when)]; *link != NULL; link = &(*link)->next)
+	{
+		if (*link == ev)
+		{
+			*link = ev->next;
+			break;
+		}
+	}
+	ev->pending = 0;
+	--schedPending;
+	SchedFindNext(schedNext);		/* others are due no earlier */
+}
+
+/*
+ *  ===== SchedRun =====
+ *      Fire every event due at or before now, in time order.  Handlers
+ *  may schedule further events (including ones already due).
+ */
+void SchedRun(NANO_TIME now)
+{
+	while (schedPending && SCHED_DUE(schedNext, now))
+	{
+		NANO_EVENT** link = &schedWheel[SLOT_OF(schedNext)];
+		NANO_EVENT* ev = NULL;
+		for (; *link != NULL; link = &(*link)->next)
+		{
+			if ((*link)->when == schedNext)
+			{
+				ev = *link;
+				*link = ev->next;
+				break;
+			}
+		}
+		if (ev == NULL)
+		{
+			SchedFindNext(schedNext);	/* stale: should not happen */
+			continue;
+		}
+		ev->pending = 0;
+		--schedPending;
+		SchedFindNext(ev->when);
+		ev->func(ev->ctx, ev->when);
+	}
+}
+
+/*
+ *  ===== SchedBudget =====
+ *      Fire due events and return how many instructions (at least one
+ *  cycle each) may run before the next event, at most max.
+ */
+long SchedBudget(NANO_TIME now, long max)
+{
+	NANO_TIME ahead;
+	SchedRun(now);
+	if (!schedPending)
+		return max;
+	ahead = schedNext - now;
+	return (ahead < (NANO_TIME) max) ? (long) ahead : max;
+}
+
+/*
+ *  ===== SchedIdle =====
+ *      The CPU is spinning on an instruction of the given cycles that
+ *  branches to itself.  Returns how many more times it can be repeated
+ *  before the next event is due, at most max.
+ */
+long SchedIdle(NANO_TIME now, NANO_TIME cycles, long max)
+{
+	NANO_TIME ahead, times;
+	if (!schedPending || cycles == 0)
+		return max;
+	if (SCHED_DUE(schedNext, now))
+		return 0;
+	ahead = schedNext - now;
+	times = (ahead + cycles - 1) / cycles;
+	return (times < (NANO_TIME) max) ? (long) times : max;
+}
+
+/*
+ *  ===== SchedHold =====
+ *      While held no event is due, so engines run as if none were
+ *  scheduled; releasing the hold makes them due again.  Events must not
+ *  be added or cancelled while held.  Used to replay instructions whose
+ *  events have already fired.
+ */
+void SchedHold(int hold)
+{
+	static int held = -1;		/* pending count while held */
+	if (hold && held < 0)
+	{
+		held = schedPending;
+		schedPending = 0;
+	}
+	else if (!hold && held >= 0)
+	{
+		schedPending = held;
+		held = -1;
+	}
+}
@@ -0,0 +1,62 @@
+/* nanosched.h */
+
+#ifndef __NANOSCHED_H__
+#define __NANOSCHED_H__
+
+#include "NanoCpu.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *  Cycle based event scheduler
+ *
+ *  Events are kept in a timing wheel of SCHED_SLOTS lists, each covering
+ *  SCHED_SLOT_CYCLES cycles of NANO_CPU::cycles; events further out than
+ *  one turn wait in their slot until their turn comes round.  Engines do
+ *  not poll per instruction: they ask SchedBudget how many instructions
+ *  may run before the next event is due and run that many before asking
+ *  again, so events fire at the first budget boundary at or after their
+ *  time.  Event structures are owned by the caller.
+ */
+
+#define SCHED_SLOT_SHIFT	4
+#define SCHED_SLOT_CYCLES	(1 << SCHED_SLOT_SHIFT)
+#define SCHED_SLOTS			256					/* power of 2 */
+
+/* Wrap safe: non-zero once time "when" has been reached at "now" */
+#define SCHED_DUE(when, now)	((long) ((now) - (when)) >= 0)
+
+typedef void (*NANO_EVENT_FUNC)(void* ctx, NANO_TIME when);
+
+typedef struct nano_event
+{
+	NANO_TIME when;				/* cycle the event is due */
+	NANO_EVENT_FUNC func;
+	void* ctx;
+	struct nano_event* next;
+	int pending;				/* non-zero while scheduled */
+} NANO_EVENT;
+
+void SchedInit(void);
+void SchedAttach(volatile NANO_TIME* clock);
+NANO_TIME SchedTime(void);
+void SchedAdd(NANO_EVENT* ev, NANO_TIME when);
+void SchedCancel(NANO_EVENT* ev);
+void SchedRun(NANO_TIME now);
+long SchedBudget(NANO_TIME now, long max);
+long SchedIdle(NANO_TIME now, NANO_TIME cycles, long max);
+void SchedHold(int hold);
+
+/* Fire due events (per instruction; for the single step interpreter) */
+extern int schedPending;
+extern NANO_TIME schedNext;
+#define SCHED_POLL(now)	{ if (schedPending && SCHED_DUE(schedNext, now)) SchedRun(now); }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOSCHED_H__ */
@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include "NanoThread.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+typedef struct
+{
+	NANO_THREAD_FUNC func;
+	void* arg;
+} THREAD_START;
+
+#ifdef _WIN32
+static DWORD WINAPI ThreadMain(LPVOID param)
+#else
+static void* ThreadMain(void* param)
+#endif
+{
+	THREAD_START start = *(THREAD_START*) param;
+	free(param);
+	start.func(start.arg);
+	return 0;
+}
+
+/* Start func(arg) on a new thread.  Returns 0 on success. */
+int NanoThreadStart(NANO_THREAD* thread, NANO_THREAD_FUNC func, void* arg)
+{
+	THREAD_START* start = (THREAD_START*) malloc(sizeof(THREAD_START));
+	if (start == NULL)
+		return -1;
+	start->func = func;
+	start->arg = arg;
+#ifdef _WIN32
+	*thread = CreateThread(NULL, 0, ThreadMain, start, 0, NULL);
+	if (*thread == NULL)
+#else
+	if (pthread_create(thread, NULL, ThreadMain, start) != 0)
+#endif
+	{
+		free(start);
+		return -1;
+	}
+	return 0;
+}
+
+void NanoThreadJoin(NANO_THREAD* thread)
+{
+#ifdef _WIN32
+	WaitForSingleObject(*thread, INFINITE);
+	CloseHandle(*thread);
+#else
+	pthread_join(*thread, NULL);
+#endif
+}
+
+/* Number of processors the host can run threads on */
+int NanoThreadCount(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int) info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return (count > 0) ? (int) count : 1;
+#endif
+}
+
+void NanoSleepMs(int ms)
+{
+#ifdef _WIN32
+	Sleep(ms);
+#else
+	struct timespec ts;
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (long) (ms % 1000) * 1000000L;
+	nanosleep(&ts, NULL);
+#endif
+}
+
+void NanoSleepUs(long us)
+{
+#ifdef _WIN32
+	Sleep((DWORD) ((us + 999) / 1000));
+#else
+	struct timespec ts;
+	ts.tv_sec = us / 1000000L;
+	ts.tv_nsec = (us % 1000000L) * 1000L;
+	nanosleep(&ts, NULL);
+#endif
+}
+
+/* Monotonic wall clock for pacing; only differences are meaningful */
+NANO_USEC NanoTimeUs(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER count, freq;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&freq);
+	return (NANO_USEC) (count.QuadPart / freq.QuadPart) * 1000000
+		+ (NANO_USEC) (count.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (NANO_USEC) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
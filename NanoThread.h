@@ -0,0 +1,32 @@
+/* nanothread.h */
+
+#ifndef __NANOTHREAD_H__
+#define __NANOTHREAD_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifdef _WIN32
+typedef void* NANO_THREAD;				/* HANDLE */
+#else
+#include <pthread.h>
+typedef pthread_t NANO_THREAD;
+#endif
+
+typedef void (*NANO_THREAD_FUNC)(void* arg);
+typedef unsigned long long NANO_USEC;		/* microseconds */
+
+int NanoThreadStart(NANO_THREAD* thread, NANO_THREAD_FUNC func, void* arg);
+void NanoThreadJoin(NANO_THREAD* thread);
+int NanoThreadCount(void);
+void NanoSleepMs(int ms);
+void NanoSleepUs(long us);
+NANO_USEC NanoTimeUs(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOTHREAD_H__ */
@@ -0,0 +1,148 @@
+/*
+ *  NanoTick: example peripheral plugin
+ *
+ *  Build with "make plugins" and load with NanoRun -p ./NanoTick.so (or
+ *  list it in $NANOSIM_PLUGINS).  TICK_COUNT counts periods of
+ *  TICK_PERIOD cycles, driven by an event scheduled through the host.
+ *  Bytes stored to TICK_DATA are added to TICK_SUM; a DMA streaming to
+ *  TICK_DATA reaches the fifo handler as one batch.
+ */
+
+#include <string.h>
+#include "NanoPlugin.h"
+
+#define TICK_BASE		0xF900
+#define TICK_COUNT		(TICK_BASE + 0x00)	/* periods elapsed, write clears */
+#define TICK_PERIOD		(TICK_BASE + 0x02)	/* cycles per period, 0 = stopped */
+#define TICK_SUM		(TICK_BASE + 0x04)	/* sum of bytes stored, write clears */
+#define TICK_DATA		(TICK_BASE + 0x06)	/* write only */
+
+typedef struct
+{
+	NANO_SHORT count;
+	NANO_SHORT period;
+	NANO_SHORT sum;
+} TICK_STATE;
+
+static const NANO_HOST* tickHost;
+static TICK_STATE tick;
+static NANO_EVENT tickEvent;
+
+static void TickExpire(void* ctx, NANO_TIME when)
+{
+	++tick.count;
+	/* from the due time, so periods do not drift */
+	tickHost->Schedule(&tickEvent, when + tick.period);
+}
+
+static void TickStart(void)
+{
+	tickHost->Cancel(&tickEvent);
+	if (tick.period != 0)
+		tickHost->Schedule(&tickEvent, tickHost->Time() + tick.period);
+}
+
+static int TickRead(void* ctx, NANO_ADDR addr, NANO_SHORT* data)
+{
+	switch (addr & ~1)
+	{
+	case TICK_COUNT:
+		*data = tick.count;
+		break;
+	case TICK_PERIOD:
+		*data = tick.period;
+		break;
+	case TICK_SUM:
+		*data = tick.sum;
+		break;
+	default:
+		*data = 0;
+	}
+	return 1;
+}
+
+static int TickWrite(void* ctx, NANO_ADDR addr, NANO_SHORT data)
+{
+	switch (addr & ~1)
+	{
+	case TICK_COUNT:
+		tick.count = 0;
+		break;
+	case TICK_PERIOD:
+		tick.period = data;
+		TickStart();
+		break;
+	case TICK_SUM:
+		tick.sum = 0;
+		break;
+	case TICK_DATA:
+		tick.sum = (NANO_SHORT) (tick.sum + (data & 0xFF));
+		break;
+	}
+	return 1;
+}
+
+/* Successive byte stores to one register in a single call */
+static int TickFifo(void* ctx, NANO_ADDR addr, const unsigned char* data, NANO_ADDR count)
+{
+	NANO_ADDR i;
+	if ((addr & ~1) != TICK_DATA)
+	{
+		for (i = 0; i < count; ++i)
+			TickWrite(ctx, addr, data[i]);
+		return (int) count;
+	}
+	for (i = 0; i < count; ++i)
+		tick.sum = (NANO_SHORT) (tick.sum + data[i]);
+	return (int) count;
+}
+
+static void TickReset(void* ctx)
+{
+	tick.count = tick.period = tick.sum = 0;
+	tickHost->Cancel(&tickEvent);
+}
+
+static size_t TickSave(void* ctx, void* buf, size_t size)
+{
+	if (buf != NULL && size >= sizeof(TICK_STATE))
+		memcpy(buf, &tick, sizeof(TICK_STATE));
+	return sizeof(TICK_STATE);
+}
+
+/* The period restarts from the time of the restore */
+static int TickRestore(void* ctx, const void* buf, size_t size)
+{
+	if (size != sizeof(TICK_STATE))
+		return -1;
+	memcpy(&tick, buf, sizeof(TICK_STATE));
+	TickStart();
+	return 0;
+}
+
+static const NANO_RANGE tickRange =
+{
+	TICK_BASE, MEM_PAGE_SIZE
+};
+
+static const NANO_PLUGIN tickPlugin =
+{
+	NANO_PLUGIN_VERSION,
+	{ "tick", TickRead, TickWrite, NULL, TickFifo },
+	&tickRange, 1,
+	TickReset,
+	TickSave,
+	TickRestore,
+	NULL
+};
+
+NANO_PLUGIN_EXPORT const NANO_PLUGIN* NanoPluginInit(const NANO_HOST* host)
+{
+	if (host->version != NANO_PLUGIN_VERSION)
+		return NULL;
+	tickHost = host;
+	tickEvent.func = TickExpire;
+	tickEvent.ctx = NULL;
+	TickReset(NULL);
+	return &tickPlugin;
+}
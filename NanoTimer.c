@@ -0,0 +1,98 @@
+#include "NanoTimer.h"
+
+static NANO_SHORT tmrReload = 0;
+static NANO_SHORT tmrCtrl = 0;
+static NANO_SHORT tmrStatus = 0;
+static NANO_SHORT tmrPrescale = 0;
+static NANO_EVENT tmrEvent;
+
+#define TMR_PERIOD()	((NANO_TIME) tmrReload * (tmrPrescale + 1))
+
+static void TimerExpire(void* ctx, NANO_TIME when)
+{
+	tmrStatus |= TMR_EXPIRED;
+	/* reload from the due time, not from when we noticed, so no drift */
+	if ((tmrCtrl & TMR_PERIODIC) && tmrReload != 0)
+		SchedAdd(&tmrEvent, when + TMR_PERIOD());
+	else
+		tmrCtrl &= ~TMR_ENABLE;
+}
+
+static void TimerStart(void)
+{
+	SchedCancel(&tmrEvent);
+	if ((tmrCtrl & TMR_ENABLE) && tmrReload != 0)
+		SchedAdd(&tmrEvent, SchedTime() + TMR_PERIOD());
+}
+
+static int TimerRead(void* ctx, NANO_ADDR addr, NANO_SHORT* data)
+{
+	/*
+	 * The fast engine fires events between budgets, so expiry may be due
+	 * but not yet fired: fire it now, so the guest sees the same count
+	 * and status whichever engine runs it.
+	 */
+	if (tmrEvent.pending && SCHED_DUE(tmrEvent.when, SchedTime()))
+		SchedRun(SchedTime());
+	switch (addr & ~1)
+	{
+	case TMR_COUNT:
+		*data = 0;
+		if (tmrEvent.pending && !SCHED_DUE(tmrEvent.when, SchedTime()))
+		{
+			NANO_TIME left = tmrEvent.when - SchedTime();
+			*data = (NANO_SHORT) ((left + tmrPrescale) / (tmrPrescale + 1));
+		}
+		break;
+	case TMR_RELOAD:
+		*data = tmrReload;
+		break;
+	case TMR_CTRL:
+		*data = tmrCtrl;
+		break;
+	case TMR_STATUS:
+		*data = tmrStatus;
+		break;
+	case TMR_PRESCALE:
+		*data = tmrPrescale;
+		break;
+	default:
+		*data = 0;
+	}
+	return 1;
+}
+
+static int TimerWrite(void* ctx, NANO_ADDR addr, NANO_SHORT data)
+{
+	switch (addr & ~1)
+	{
+	case TMR_RELOAD:
+		tmrReload = data;
+		break;
+	case TMR_CTRL:
+		tmrCtrl = data;
+		TimerStart();
+		break;
+	case TMR_STATUS:
+		tmrStatus &= ~data;
+		break;
+	case TMR_PRESCALE:
+		tmrPrescale = data;
+		break;
+	}
+	return 1;
+}
+
+static const NANO_DEVICE timerDevice =
+{
+	"timer", TimerRead, TimerWrite, NULL
+};
+
+void TimerInit(void)
+{
+	SchedCancel(&tmrEvent);
+	tmrEvent.func = TimerExpire;
+	tmrEvent.ctx = NULL;
+	tmrReload = tmrCtrl = tmrStatus = tmrPrescale = 0;
+	MemMapDevice(TMR_BASE, MEM_PAGE_SIZE, &timerDevice);
+}
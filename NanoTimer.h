@@ -0,0 +1,41 @@
+/* nanotimer.h */
+
+#ifndef __NANOTIMER_H__
+#define __NANOTIMER_H__
+
+#include "NanoMem.h"
+#include "NanoSched.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *  Programmable timer
+ *
+ *  Counts TMR_RELOAD ticks of (TMR_PRESCALE + 1) CPU cycles down to zero,
+ *  then sets TMR_EXPIRED and, in periodic mode, reloads.  Expiry is a
+ *  scheduler event so nothing is polled per instruction.  TMR_COUNT reads
+ *  the ticks remaining.
+ */
+
+#define TMR_BASE		0xFA00
+#define TMR_COUNT		(TMR_BASE + 0x00)	/* read only */
+#define TMR_RELOAD		(TMR_BASE + 0x02)
+#define TMR_CTRL		(TMR_BASE + 0x04)
+#define TMR_STATUS		(TMR_BASE + 0x06)	/* write 1s to clear */
+#define TMR_PRESCALE	(TMR_BASE + 0x08)
+
+#define TMR_ENABLE		0x0001				/* CTRL: start counting */
+#define TMR_PERIODIC	0x0002				/* CTRL: reload on expiry */
+
+#define TMR_EXPIRED		0x0001				/* STATUS: count reached zero */
+
+void TimerInit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOTIMER_H__ */
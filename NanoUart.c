@@ -0,0 +1,372 @@
+#ifndef _WIN32
+#define _XOPEN_SOURCE	600		/* posix_openpt & friends */
+#define _DEFAULT_SOURCE			/* cfmakeraw */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NanoUart.h"
+#include "NanoAtomic.h"
+#include "NanoThread.h"
+#include "NanoVcd.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#define write	_write
+#define read	_read
+#define open	_open
+#define close	_close
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#endif
+
+#define TX_MASK		(UART_TX_SIZE - 1)
+#define RX_MASK		(UART_RX_SIZE - 1)
+#define RX_BATCH	256
+#define RX_POLL_MS	100
+
+static char txBuf[UART_TX_SIZE];
+static volatile unsigned txHead = 0;		/* next byte written by guest */
+static volatile unsigned txTail = 0;		/* next byte drained to sink */
+
+static unsigned char rxBuf[UART_RX_SIZE];
+static volatile unsigned rxHead = 0;		/* next byte stored by helper */
+static volatile unsigned rxTail = 0;		/* next byte read by guest */
+static volatile unsigned rxLost = 0;		/* overruns (helper) */
+static unsigned rxLostSeen = 0;				/* overruns reported (guest) */
+
+static NANO_THREAD rxThread;
+static volatile int rxRunning = 0;
+static int rxFd = -1;
+
+static NANO_UART_SINK uartSink = NULL;
+static void* uartCtx = NULL;
+static int uartFd = -1;
+static int uartWait = 0;
+
+/*
+ *  ===== UartFlush =====
+ *      Drain the transmit ring to the sink in at most two contiguous
+ *  batches.  Without a sink the data is discarded.  Returns the number
+ *  of bytes drained.
+ */
+int UartFlush(void)
+{
+	unsigned head = NANO_LOAD_ACQUIRE(txHead);
+	unsigned tail = txTail;
+	int total = (int) (head - tail);
+
+	while (tail != head)
+	{
+		unsigned start = tail & TX_MASK;
+		unsigned count = head - tail;
+		if (count > UART_TX_SIZE - start)
+			count = UART_TX_SIZE - start;
+		if (uartSink != NULL)
+			uartSink(uartCtx, &txBuf[start], (int) count);
+		tail += count;
+	}
+	NANO_STORE_RELEASE(txTail, tail);
+	return total;
+}
+
+/* Transmit ring full: drain it here, or wait for the thread that does */
+static void UartMakeRoom(void)
+{
+	if (!uartWait)
+	{
+		UartFlush();
+		return;
+	}
+	while (txHead - NANO_LOAD_ACQUIRE(txTail) == UART_TX_SIZE)
+		NanoSleepMs(1);
+}
+
+static NANO_SHORT UartStatus(unsigned lost)
+{
+	NANO_SHORT status = UART_TXRDY;
+	if (NANO_LOAD_ACQUIRE(rxHead) != rxTail)
+		status |= UART_RXRDY;
+	if (lost != rxLostSeen)
+		status |= UART_OVERRUN;
+	return status;
+}
+
+static int UartRead(void* ctx, NANO_ADDR addr, NANO_SHORT* data)
+{
+	unsigned lost = NANO_LOAD_ACQUIRE(rxLost);
+	NANO_SHORT status = UartStatus(lost);
+	NANO_SHORT byte = 0;
+	if ((addr & 0xFF01) == UART_DATA && (status & UART_RXRDY))
+	{
+		unsigned tail = rxTail;
+		byte = rxBuf[tail & RX_MASK];
+		NANO_STORE_RELEASE(rxTail, tail + 1);
+	}
+	/* only overruns already counted when the status was read are cleared */
+	if ((addr & 0xFF01) == UART_STATUS)
+		rxLostSeen = lost;
+	*data = (NANO_SHORT) ((status << 8) | byte);
+	return 1;
+}
+
+static int UartWrite(void* ctx, NANO_ADDR addr, NANO_SHORT data)
+{
+	if ((addr & 0xFF01) == UART_DATA)
+	{
+		if (txHead - txTail == UART_TX_SIZE)
+			UartMakeRoom();
+		txBuf[txHead & TX_MASK] = (char) data;
+		NANO_STORE_RELEASE(txHead, txHead + 1);
+		if (vcdActive)
+			VcdUartByte(data);
+	}
+	return 1;
+}
+
+/* Batched stores to the data register: copy runs into the ring */
+static int UartFifo(void* ctx, NANO_ADDR addr, const unsigned char* data, NANO_ADDR count)
+{
+	NANO_ADDR done = 0;
+	if ((addr & 0xFF01) != UART_DATA)
+		return (int) count;
+	if (vcdActive)
+	{
+		NANO_ADDR i;
+		for (i = 0; i < count; ++i)
+			VcdUartByte(data[i]);
+	}
+	while (done < count)
+	{
+		unsigned start = txHead & TX_MASK;
+		unsigned room = UART_TX_SIZE - (txHead - txTail);
+		unsigned n = (unsigned) (count - done);
+		if (room == 0)
+		{
+			UartMakeRoom();
+			continue;
+		}
+		if (n > room)
+			n = room;
+		if (n > UART_TX_SIZE - start)
+			n = UART_TX_SIZE - start;
+		memcpy(&txBuf[start], data + done, n);
+		NANO_STORE_RELEASE(txHead, txHead + n);
+		done += n;
+	}
+	return (int) count;
+}
+
+static const NANO_DEVICE uartDevice =
+{
+	"uart", UartRead, UartWrite, NULL, UartFifo
+};
+
+void UartInit(void)
+{
+	txHead = txTail = 0;
+	rxHead = rxTail = 0;
+	rxLostSeen = rxLost;
+	MemMapDevice(UART_DATA, MEM_PAGE_SIZE, &uartDevice);
+}
+
+/* Another thread calls UartFlush: a full ring waits for it to drain */
+void UartSetWait(int wait)
+{
+	uartWait = wait;
+}
+
+void UartSetSink(NANO_UART_SINK sink, void* ctx)
+{
+	UartFlush();
+	uartSink = sink;
+	uartCtx = ctx;
+}
+
+static void UartFdSink(void* ctx, const char* data, int length)
+{
+	while (length > 0)
+	{
+		int n = (int) write(uartFd, data, length);
+		if (n <= 0)
+			break;
+		data += n;
+		length -= n;
+	}
+}
+
+/* Drain to a file descriptor (headless runs) */
+void UartSetFd(int fd)
+{
+	UartSetSink(NULL, NULL);
+	uartFd = fd;
+	if (fd >= 0)
+		UartSetSink(UartFdSink, NULL);
+}
+
+/*
+ *  ===== UartReceive =====
+ *      Queue received bytes.  Returns the number accepted; bytes that do
+ *  not fit are dropped and flagged as an overrun.
+ */
+int UartReceive(const char* data, int length)
+{
+	unsigned head = rxHead;
+	unsigned room = UART_RX_SIZE - (head - NANO_LOAD_ACQUIRE(rxTail));
+	int i;
+
+	if ((unsigned) length > room)
+	{
+		NANO_STORE_RELEASE(rxLost, rxLost + 1);
+		length = (int) room;
+	}
+	for (i = 0; i < length; ++i)
+		rxBuf[(head + i) & RX_MASK] = (unsigned char) data[i];
+	NANO_STORE_RELEASE(rxHead, head + length);
+	return length;
+}
+
+/*
+ *  ===== RxWait =====
+ *      Wait up to RX_POLL_MS for input on fd, so the helper thread sees a
+ *  close request in time.  Returns > 0 if a read will not block, 0 on
+ *  timeout and < 0 on error.  On Windows pipes are peeked and consoles
+ *  waited on; a file never blocks.
+ */
+static int RxWait(int fd)
+{
+#ifdef _WIN32
+	HANDLE h = (HANDLE) _get_osfhandle(fd);
+	DWORD avail = 0;
+	int ms;
+	if (h == INVALID_HANDLE_VALUE)
+		return -1;
+	switch (GetFileType(h))
+	{
+	case FILE_TYPE_PIPE:
+		for (ms = 0; ms < RX_POLL_MS; ms += 10)
+		{
+			if (!PeekNamedPipe(h, NULL, 0, NULL, &avail, NULL))
+				return 1;			/* broken pipe: let read see the end */
+			if (avail != 0)
+				return 1;
+			NanoSleepMs(10);
+		}
+		return 0;
+	case FILE_TYPE_CHAR:
+		return (WaitForSingleObject(h, RX_POLL_MS) == WAIT_OBJECT_0) ? 1 : 0;
+	default:
+		return 1;
+	}
+#else
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	return poll(&pfd, 1, RX_POLL_MS);
+#endif
+}
+
+static void RxThread(void* arg)
+{
+	char batch[RX_BATCH];
+	while (rxRunning)
+	{
+		int n, done;
+		int ready = RxWait(rxFd);
+		if (ready < 0)
+			break;
+		if (ready == 0)
+			continue;
+		n = (int) read(rxFd, batch, sizeof(batch));
+		if (n <= 0)
+			break;				/* end of file or error */
+		/* hand the batch over as FIFO space frees up */
+		for (done = 0; done < n && rxRunning; )
+		{
+			unsigned room = UART_RX_SIZE - (rxHead - NANO_LOAD_ACQUIRE(rxTail));
+			if (room == 0)
+			{
+				NanoSleepMs(1);
+				continue;
+			}
+			if (room > (unsigned) (n - done))
+				room = (unsigned) (n - done);
+			done += UartReceive(batch + done, (int) room);
+		}
+	}
+}
+
+#ifndef _WIN32
+/* Create a raw mode pty and report its slave name for the user */
+static int OpenPty(void)
+{
+	struct termios tio;
+	int fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (fd < 0)
+		return -1;
+	if (grantpt(fd) < 0 || unlockpt(fd) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	if (tcgetattr(fd, &tio) == 0)
+	{
+		cfmakeraw(&tio);
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	fprintf(stderr, "uart: connect to %s\n", ptsname(fd));
+	return fd;
+}
+#endif
+
+/*
+ *  ===== UartOpenInput =====
+ *      Start feeding the receive FIFO from source: UART_SRC_STDIN,
+ *  UART_SRC_PTY, or the path of a file or named pipe.  Returns 0 on
+ *  success.
+ */
+int UartOpenInput(const char* source)
+{
+	UartCloseInput();
+	if (strcmp(source, UART_SRC_STDIN) == 0)
+		rxFd = 0;
+#ifndef _WIN32
+	else if (strcmp(source, UART_SRC_PTY) == 0)
+		rxFd = OpenPty();
+#endif
+	else
+		rxFd = open(source, O_RDONLY);
+	if (rxFd < 0)
+		return -1;
+	rxRunning = 1;
+	if (NanoThreadStart(&rxThread, RxThread, NULL) != 0)
+	{
+		rxRunning = 0;
+		if (rxFd > 0)
+			close(rxFd);
+		rxFd = -1;
+		return -1;
+	}
+	return 0;
+}
+
+void UartCloseInput(void)
+{
+	if (rxFd < 0)
+		return;
+	rxRunning = 0;
+#ifdef _WIN32
+	/* a console read waits for a whole line: abandon it */
+	CancelSynchronousIo((HANDLE) rxThread);
+#endif
+	NanoThreadJoin(&rxThread);
+	if (rxFd > 0)
+		close(rxFd);
+	rxFd = -1;
+}
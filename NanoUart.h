@@ -0,0 +1,62 @@
+/* nanouart.h */
+
+#ifndef __NANOUART_H__
+#define __NANOUART_H__
+
+#include "NanoMem.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *  UART
+ *
+ *  Bytes written to UART_DATA go into a transmit ring buffer owned by the
+ *  device.  The buffer is drained in batches to a sink by UartFlush, which
+ *  the front end calls from its refresh timer or at exit, and also when
+ *  the ring fills up.  Output speed is bounded by the CPU engine, not by
+ *  the sink.  When the engine runs on a thread of its own, UartSetWait
+ *  makes a full ring wait for the front end to drain it instead, so the
+ *  sink is only ever called on the front end's thread.
+ *
+ *  Received bytes come from a receive FIFO fed by a helper thread that
+ *  reads the input source (stdin, a file, a named pipe or a pty) in
+ *  batches, so the CPU never blocks on host I/O.  When the FIFO is full
+ *  the helper waits.  A byte read of UART_STATUS returns the status; a
+ *  read of UART_DATA pops the next byte and returns (status << 8) | byte,
+ *  with the status as it was before the pop.
+ */
+
+#define UART_DATA		0xFD00
+#define UART_STATUS		0xFD01
+
+#define UART_TX_SIZE	4096				/* power of 2 */
+#define UART_RX_SIZE	1024				/* power of 2 */
+
+#define UART_RXRDY		0x01				/* STATUS: receive data ready */
+#define UART_OVERRUN	0x02				/* STATUS: byte lost, cleared by reading STATUS */
+#define UART_TXRDY		0x80				/* STATUS: transmitter ready */
+
+/* Input source for UartOpenInput: "-" = stdin, "pty" = new pty, else path */
+#define UART_SRC_STDIN	"-"
+#define UART_SRC_PTY	"pty"
+
+typedef void (*NANO_UART_SINK)(void* ctx, const char* data, int length);
+
+void UartInit(void);
+void UartSetSink(NANO_UART_SINK sink, void* ctx);
+void UartSetFd(int fd);
+void UartSetWait(int wait);
+int UartFlush(void);
+
+int UartOpenInput(const char* source);
+void UartCloseInput(void);
+int UartReceive(const char* data, int length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOUART_H__ */
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "NanoVcd.h"
+#include "NanoMem.h"
+#include "NanoSched.h"
+#include "NanoAtomic.h"
+#include "NanoThread.h"
+
+#define VCD_MASK		(VCD_RING_SIZE - 1)
+#define VCD_RELEASE		1024			/* free ring space at least this often */
+#define VCD_POLL_MS		10
+#define VCD_ID(sig)		((char) ('!' + (sig)))
+
+typedef struct
+{
+	NANO_TIME when;
+	NANO_LONG value;
+	int sig;
+} VCD_CHANGE_REC;
+
+static VCD_CHANGE_REC vcdRing[VCD_RING_SIZE];
+static volatile unsigned vcdHead = 0;		/* next change queued by engine */
+static volatile unsigned vcdTail = 0;		/* next change written by writer */
+
+static NANO_LONG vcdLast[VCD_SIGNALS];
+static int vcdKnown[VCD_SIGNALS];			/* vcdLast holds a value */
+static int vcdWidth[VCD_SIGNALS];
+
+static FILE* vcdFile = NULL;
+static NANO_THREAD vcdThread;
+static volatile int vcdRunning = 0;
+
+int vcdActive = 0;
+
+static const char* const vcdName[VCD_SIGNALS] =
+{
+	"gpio_out", "gpio_in", "uart_tx", "uart_stb", "pc",
+	"bus_addr", "bus_data", "bus_kind", "bus_stb"
+};
+
+/* Queue a change, waiting for the writer if the ring is full */
+static void VcdQueue(int sig, NANO_LONG value)
+{
+	unsigned head = vcdHead;
+	VCD_CHANGE_REC* rec;
+
+	while (head - NANO_LOAD_ACQUIRE(vcdTail) == VCD_RING_SIZE)
+		NanoSleepMs(1);
+	rec = &vcdRing[head & VCD_MASK];
+	rec->when = SchedTime();
+	rec->value = value;
+	rec->sig = sig;
+	NANO_STORE_RELEASE(vcdHead, head + 1);
+}
+
+void VcdChange(int sig, NANO_LONG value)
+{
+	if (vcdKnown[sig] && vcdLast[sig] == value)
+		return;
+	vcdKnown[sig] = 1;
+	vcdLast[sig] = value;
+	VcdQueue(sig, value);
+}
+
+/* A byte sent: the strobe toggles so repeated bytes still show */
+void VcdUartByte(int byte)
+{
+	VcdChange(VCD_UART_TX, (NANO_LONG) (byte & 0xFF));
+	VcdChange(VCD_UART_STB, vcdLast[VCD_UART_STB] ^ 1);
+}
+
+static void VcdBusTrace(NANO_ADDR addr, NANO_SHORT data, int kind)
+{
+	VcdChange(VCD_BUS_ADDR, addr);
+	VcdChange(VCD_BUS_DATA, data);
+	VcdChange(VCD_BUS_KIND, (NANO_LONG) kind);
+	VcdChange(VCD_BUS_STB, vcdLast[VCD_BUS_STB] ^ 1);
+}
+
+static void VcdWriteValue(FILE* fp, int sig, NANO_LONG value)
+{
+	char bits[40];
+	int n = 0;
+
+	if (vcdWidth[sig] == 1)
+	{
+		fprintf(fp, "%d%c\n", (int) (value & 1), VCD_ID(sig));
+		return;
+	}
+	do
+	{
+		bits[n++] = (char) ('0' + (value & 1));
+		value >>= 1;
+	} while (value != 0 && n < vcdWidth[sig]);
+	fputc('b', fp);
+	while (n > 0)
+		fputc(bits[--n], fp);
+	fprintf(fp, " %c\n", VCD_ID(sig));
+}
+
+/*
+ *  ===== VcdWriter =====
+ *      Writer thread: format queued changes into the (buffered) file.
+ *  Time only moves forwards in a VCD file, so a change stamped earlier
+ *  than the last (e.g. from a verification re-run) is written at the
+ *  current time.
+ */
+static void VcdWriter(void* arg)
+{
+	FILE* fp = (FILE*) arg;
+	NANO_TIME now = 0;
+	unsigned tail = vcdTail;
+
+	for (;;)
+	{
+		int running = vcdRunning;
+		unsigned head = NANO_LOAD_ACQUIRE(vcdHead);
+		if (head == tail)
+		{
+			if (!running)
+				break;
+			fflush(fp);
+			NanoSleepMs(VCD_POLL_MS);
+			continue;
+		}
+		while (tail != head)
+		{
+			const VCD_CHANGE_REC* rec = &vcdRing[tail & VCD_MASK];
+			if (rec->when > now)
+			{
+				now = rec->when;
+				fprintf(fp, "#%lu\n", (unsigned long) now);
+			}
+			VcdWriteValue(fp, rec->sig, rec->value);
+			++tail;
+			if ((tail & (VCD_RELEASE - 1)) == 0)
+				NANO_STORE_RELEASE(vcdTail, tail);
+		}
+		NANO_STORE_RELEASE(vcdTail, tail);
+	}
+	fflush(fp);
+}
+
+/*
+ *  ===== VcdOpen =====
+ *      Start recording to path for a core of the given bits.  Returns 0,
+ *  or -1 if the file cannot be created.
+ */
+int VcdOpen(const char* path, int bits, int flags)
+{
+	int sig;
+
+	VcdClose();
+	vcdFile = fopen(path, "w");
+	if (vcdFile == NULL)
+		return -1;
+	setvbuf(vcdFile, NULL, _IOFBF, 65536);
+
+	vcdWidth[VCD_GPIO_OUT] = vcdWidth[VCD_GPIO_IN] = 16;
+	vcdWidth[VCD_UART_TX] = 8;
+	vcdWidth[VCD_UART_STB] = vcdWidth[VCD_BUS_STB] = 1;
+	vcdWidth[VCD_PC] = vcdWidth[VCD_BUS_ADDR] = bits;
+	vcdWidth[VCD_BUS_DATA] = 16;
+	vcdWidth[VCD_BUS_KIND] = 2;
+
+	fprintf(vcdFile, "$version NanoSim $end\n$timescale 1ns $end\n");
+	fprintf(vcdFile, "$comment one time unit per CPU cycle $end\n");
+	fprintf(vcdFile, "$scope module nano $end\n");
+	for (sig = 0; sig < VCD_SIGNALS; ++sig)
+	{
+		if (sig >= VCD_BUS_ADDR && (flags & VCD_BUS) == 0)
+			break;
+		fprintf(vcdFile, "$var wire %d %c %s $end\n", vcdWidth[sig], VCD_ID(sig), vcdName[sig]);
+	}
+	fprintf(vcdFile, "$upscope $end\n$enddefinitions $end\n#%lu\n", (unsigned long) SchedTime());
+
+	vcdHead = vcdTail = 0;
+	for (sig = 0; sig < VCD_SIGNALS; ++sig)
+		vcdKnown[sig] = 0;
+	vcdRunning = 1;
+	if (NanoThreadStart(&vcdThread, VcdWriter, vcdFile) < 0)
+	{
+		vcdRunning = 0;
+		fclose(vcdFile);
+		vcdFile = NULL;
+		return -1;
+	}
+	vcdActive = 1;
+	VcdChange(VCD_GPIO_OUT, led_out);
+	VcdChange(VCD_GPIO_IN, sw_inp);
+	VcdChange(VCD_UART_STB, 0);
+	if (flags & VCD_BUS)
+	{
+		VcdChange(VCD_BUS_STB, 0);
+		MemSetTrace(VcdBusTrace);
+	}
+	return 0;
+}
+
+/* Stop recording: the writer drains the ring before the file is closed */
+void VcdClose(void)
+{
+	if (vcdFile == NULL)
+		return;
+	if (memTrace == VcdBusTrace)
+		MemSetTrace(NULL);
+	vcdActive = 0;
+	NANO_STORE_RELEASE(vcdRunning, 0);
+	NanoThreadJoin(&vcdThread);
+	fclose(vcdFile);
+	vcdFile = NULL;
+}
@@ -0,0 +1,57 @@
+/* nanovcd.h */
+
+#ifndef __NANOVCD_H__
+#define __NANOVCD_H__
+
+#include "NanoCpu.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *  VCD waveform export
+ *
+ *  Devices and engines report signal values as they change, timestamped
+ *  with the scheduler clock (one VCD time unit per CPU cycle).  Changes
+ *  are queued in a ring and a writer thread formats and streams them to
+ *  the file, so memory use stays flat however long the run.  Only real
+ *  changes are queued; a full ring makes the producer wait for the
+ *  writer rather than drop changes.
+ *
+ *  When no file is open the hooks reduce to a test of vcdActive and the
+ *  fast engine checks it once per call, not per instruction.  VCD_BUS
+ *  traces CPU loads and stores by sending every page down the slow path
+ *  (see MemSetTrace), which does slow the run.
+ */
+
+#define VCD_GPIO_OUT	0
+#define VCD_GPIO_IN		1
+#define VCD_UART_TX		2
+#define VCD_UART_STB	3					/* toggles on every byte sent */
+#define VCD_PC			4
+#define VCD_BUS_ADDR	5
+#define VCD_BUS_DATA	6
+#define VCD_BUS_KIND	7					/* MEM_TRACE_xxx */
+#define VCD_BUS_STB		8					/* toggles on every access */
+#define VCD_SIGNALS		9
+
+#define VCD_BUS			0x0001				/* VcdOpen: trace the bus */
+
+#define VCD_RING_SIZE	65536				/* changes queued, power of 2 */
+
+extern int vcdActive;
+
+#define VCD_CHANGE(sig, value)	{ if (vcdActive) VcdChange(sig, value); }
+
+int VcdOpen(const char* path, int bits, int flags);
+void VcdClose(void);
+void VcdChange(int sig, NANO_LONG value);
+void VcdUartByte(int byte);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOVCD_H__ */
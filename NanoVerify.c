@@ -0,0 +1,540 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NanoVerify.h"
+#include "NanoSched.h"
+#include "NanoVcd.h"
+
+#define IMG_START	0		/* memory at start of interval */
+#define IMG_STEP	1		/* memory before a single step */
+#define IMG_FAST	2		/* memory after fast engine */
+
+#define IO_OFF		0		/* devices wrapped but passed through */
+#define IO_RECORD	1		/* fast engine: perform and log */
+#define IO_REPLAY	2		/* replay: answer from the log */
+
+static NANO_VERIFY* verifyCur = NULL;
+static NANO_DEVICE verifyDev[MEM_PAGES];		/* wrappers installed */
+static const NANO_DEVICE* verifyOrig[MEM_PAGES];	/* devices wrapped */
+
+static NANO_BUS_TRACE verifyTrace;
+static int verifyVcd;
+
+/*
+ *  Reference engine: single step the interpreter count times.  Stops after
+ *  an instruction that runs the cycle count backwards, so the interval
+ *  mismatches and is located one instruction at a time.
+ */
+static long NanoRefEngine(NANO_CPU* p, long count)
+{
+	long n;
+	for (n = 0; n < count; ++n)
+	{
+		NANO_TIME cycles = p->cycles;
+		NanoSimInst(p, NANO_STEP_INTO);
+		if ((long) (p->cycles - cycles) < 0)
+			return n + 1;
+	}
+	return n;
+}
+
+/* Grow a log array to hold one more element */
+static int LogGrow(void** array, long* max, long count, size_t size)
+{
+	void* grown;
+	long want;
+	if (count < *max)
+		return 0;
+	want = (*max > 0) ? *max * 2 : 256;
+	grown = realloc(*array, want * size);
+	if (grown == NULL)
+		return -1;
+	*array = grown;
+	*max = want;
+	return 0;
+}
+
+/* Perform a device access for the fast engine and log it */
+static int IoRecord(NANO_VERIFY* v, int n, NANO_ADDR addr, NANO_SHORT* data, int write)
+{
+	const NANO_DEVICE* dev = verifyOrig[n];
+	unsigned long gen[MEM_PAGES];
+	VERIFY_IO* io;
+	int result;
+	int i;
+
+	for (i = 0; i < MEM_PAGES; ++i)
+		gen[i] = memPage[i].gen;
+	if (write)
+		result = dev->write(dev->ctx, addr, *data);
+	else
+		result = dev->read(dev->ctx, addr, data);
+	if (v->ioFull || LogGrow((void**) &v->io, &v->ioMax, v->ioCount, sizeof(VERIFY_IO)) < 0)
+	{
+		v->ioFull = 1;
+		return result;
+	}
+	io = &v->io[v->ioCount++];
+	io->addr = addr;
+	io->data = *data;
+	io->write = (short) write;
+	io->result = result;
+	io->page = v->pageCount;
+	io->pages = 0;
+	for (i = 0; i < MEM_PAGES; ++i)
+	{
+		if (memPage[i].gen == gen[i] || memPage[i].ram == NULL)
+			continue;
+		if (LogGrow((void**) &v->pages, &v->pageMax, v->pageCount, sizeof(VERIFY_PAGE)) < 0)
+		{
+			v->ioFull = 1;
+			break;
+		}
+		v->pages[v->pageCount].n = i;
+		memcpy(v->pages[v->pageCount].words, memPage[i].ram, MEM_PAGE_SIZE);
+		++v->pageCount;
+		++io->pages;
+	}
+	return result;
+}
+
+/*
+ *  ===== IoReplay =====
+ *      Answer a device access from the log: reads return the logged value,
+ *  writes are checked but not performed, and RAM pages the access changed
+ *  take their logged contents.  An access that does not match the log is
+ *  a divergence.
+ */
+static int IoReplay(NANO_VERIFY* v, NANO_ADDR addr, NANO_SHORT* data, int write)
+{
+	const VERIFY_IO* io = &v->io[v->ioPos];
+	long i;
+
+	if (v->ioPos >= v->ioCount || io->addr != addr || io->write != write ||
+		(write && io->data != *data))
+	{
+		if (!v->ioDiverged)
+		{
+			v->ioDiverged = 1;
+			v->ioAddr = addr;
+		}
+		if (!write)
+			*data = 0xDEAD;
+		return 1;
+	}
+	++v->ioPos;
+	if (!write)
+		*data = io->data;
+	for (i = io->page; i < io->page + io->pages; ++i)
+	{
+		NANO_PAGE* page = &memPage[v->pages[i].n];
+		memcpy(page->ram, v->pages[i].words, MEM_PAGE_SIZE);
+		MEM_PAGE_DIRTY(page);
+	}
+	return io->result;
+}
+
+static int IoAccess(void* ctx, NANO_ADDR addr, NANO_SHORT* data, int write)
+{
+	NANO_VERIFY* v = verifyCur;
+	int n = (int) ((const NANO_DEVICE**) ctx - verifyOrig);
+	const NANO_DEVICE* dev = verifyOrig[n];
+
+	if (v->ioMode == IO_RECORD)
+		return IoRecord(v, n, addr, data, write);
+	if (v->ioMode == IO_REPLAY)
+		return IoReplay(v, addr, data, write);
+	return write ? dev->write(dev->ctx, addr, *data) : dev->read(dev->ctx, addr, data);
+}
+
+static int IoRead(void* ctx, NANO_ADDR addr, NANO_SHORT* data)
+{
+	return IoAccess(ctx, addr, data, 0);
+}
+
+static int IoWrite(void* ctx, NANO_ADDR addr, NANO_SHORT data)
+{
+	return IoAccess(ctx, addr, &data, 1);
+}
+
+/*
+ *  ===== IoStart =====
+ *      Start logging the device accesses of a checked interval.  Device
+ *  pages get wrappers without a fifo handler, so FIFO stores are logged
+ *  a byte at a time.
+ */
+static void IoStart(NANO_VERIFY* v)
+{
+	int n;
+
+	verifyCur = v;
+	v->ioCount = v->pageCount = v->ioPos = 0;
+	v->ioFull = 0;
+	v->ioMode = IO_RECORD;
+	for (n = 0; n < MEM_PAGES; ++n)
+	{
+		NANO_PAGE* page = &memPage[n];
+		v->ram[n] = page->ram;
+		if (page->ram != NULL || page->dev == NULL)
+			continue;
+		verifyOrig[n] = page->dev;
+		verifyDev[n].name = page->dev->name;
+		verifyDev[n].read = IoRead;
+		verifyDev[n].write = IoWrite;
+		verifyDev[n].ctx = (void*) &verifyOrig[n];
+		verifyDev[n].fifo = NULL;
+		page->dev = &verifyDev[n];
+	}
+}
+
+/* Remove the wrappers (from pages devices have not since remapped) */
+static void IoStop(NANO_VERIFY* v)
+{
+	int n;
+	for (n = 0; n < MEM_PAGES; ++n)
+	{
+		if (memPage[n].dev == &verifyDev[n])
+			memPage[n].dev = verifyOrig[n];
+	}
+	v->ioMode = IO_OFF;
+	verifyCur = NULL;
+}
+
+/* Non-zero if the logged interval can be rewound and replayed */
+static int IoCheckable(const NANO_VERIFY* v)
+{
+	int n;
+	if (v->ioFull)
+		return 0;
+	for (n = 0; n < MEM_PAGES; ++n)
+	{
+		if (memPage[n].ram != v->ram[n])
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ *  ===== ReplayBegin =====
+ *      Replay from log entry pos with events held and waveform and bus
+ *  trace output off; the reference also runs on the slow path.
+ */
+static void ReplayBegin(NANO_VERIFY* v, long pos, int slow)
+{
+	v->ioMode = IO_REPLAY;
+	v->ioPos = pos;
+	SchedHold(1);
+	verifyVcd = vcdActive;
+	vcdActive = 0;
+	verifyTrace = memTrace;
+	if (verifyTrace != NULL)
+		MemSetTrace(NULL);
+	if (slow)
+		MemSetSlow(1);
+}
+
+static void ReplayEnd(NANO_VERIFY* v)
+{
+	MemSetSlow(0);
+	if (verifyTrace != NULL)
+		MemSetTrace(verifyTrace);
+	vcdActive = verifyVcd;
+	SchedHold(0);
+	v->ioMode = IO_OFF;
+}
+
+/* Instruction word at pc without touching devices */
+static NANO_INST VerifyPeek(NANO_ADDR pc)
+{
+	NANO_SHORT opc = 0;
+	if (pc < MEM_SIZE && memPage[MEM_PAGE_NUM(pc)].ram != NULL)
+		opc = memPage[MEM_PAGE_NUM(pc)].ram[MEM_PAGE_IDX(pc)];
+	else if (pc >= MEM_SIZE)
+		MemReadWord(pc, &opc);
+	return opc;
+}
+
+static int CpuEqual(const NANO_CPU* a, const NANO_CPU* b)
+{
+	return memcmp(a->reg, b->reg, sizeof(a->reg)) == 0 &&
+		a->pc == b->pc && a->ccr == b->ccr &&
+		a->prefix == b->prefix && a->cycles == b->cycles;
+}
+
+/* Cycle counts only go forwards; a wrap means an engine added a bus error's result */
+static int ClockError(const NANO_CPU* start, const NANO_CPU* ref, const NANO_CPU* fast)
+{
+	int error = 0;
+	if ((long) (fast->cycles - start->cycles) < 0)
+		error |= VERIFY_FAST_CLOCK;
+	if (ref != NULL && (long) (ref->cycles - start->cycles) < 0)
+		error |= VERIFY_REF_CLOCK;
+	return error;
+}
+
+/* Compare current (reference) memory against fast engine image */
+static int MemDiff(NANO_VERIFY* v)
+{
+	NANO_SHORT* ref = v->image[IMG_STEP];
+	NANO_SHORT* fast = v->image[IMG_FAST];
+	int i;
+
+	MemSaveImage(ref);
+	v->diffs = 0;
+	for (i = 0; i < NANO_MEM_WORDS; ++i)
+	{
+		if (ref[i] != fast[i])
+		{
+			if (v->diffs < VERIFY_MAX_DIFFS)
+			{
+				v->diffAddr[v->diffs] = (NANO_ADDR) (i * 2);
+				v->diffRef[v->diffs] = ref[i];
+				v->diffFast[v->diffs] = fast[i];
+			}
+			++v->diffs;
+		}
+	}
+	return v->diffs;
+}
+
+/*
+ *  ===== VerifyLocate =====
+ *      Replay a mismatching interval of n instructions one at a time
+ *  starting from the state in *p and IMG_START, with device accesses
+ *  answered from the log.  Returns the number of instructions executed.
+ */
+static long VerifyLocate(NANO_VERIFY* v, NANO_CPU* p, long n)
+{
+	NANO_CPU start = *p;
+	long pos = 0;
+	long i;
+
+	for (i = 0; i < n; ++i)
+	{
+		NANO_CPU ref = *p;
+		long fastPos;
+
+		v->start = *p;
+		v->opc = VerifyPeek(p->pc);
+		MemSaveImage(v->image[IMG_STEP]);
+		ReplayBegin(v, pos, 0);
+		v->engine(p, 1);
+		ReplayEnd(v);
+		fastPos = v->ioPos;
+		MemSaveImage(v->image[IMG_FAST]);
+		MemLoadImage(v->image[IMG_STEP]);
+		ReplayBegin(v, pos, 1);
+		NanoRefEngine(&ref, 1);
+		ReplayEnd(v);
+		v->clockError = ClockError(&v->start, &ref, p);
+		if (!CpuEqual(&ref, p) || MemDiff(v) != 0 || v->ioPos != fastPos || v->ioDiverged ||
+			v->clockError)
+		{
+			v->located = 1;
+			v->ref = ref;
+			v->fast = *p;
+			v->where = v->retired + i;
+			*p = ref;
+			return i + 1;
+		}
+		pos = fastPos;
+	}
+
+	/* Divergence does not reproduce one step at a time: report interval */
+	*p = start;
+	MemLoadImage(v->image[IMG_START]);
+	ReplayBegin(v, 0, 0);
+	v->engine(p, n);
+	ReplayEnd(v);
+	v->fast = *p;
+	MemSaveImage(v->image[IMG_FAST]);
+	MemLoadImage(v->image[IMG_START]);
+	*p = start;
+	ReplayBegin(v, 0, 1);
+	NanoRefEngine(p, n);
+	ReplayEnd(v);
+	MemDiff(v);
+	v->clockError = ClockError(&start, p, &v->fast);
+	v->located = 0;
+	v->start = start;
+	v->ref = *p;
+	v->where = v->retired;
+	return n;
+}
+
+int NanoVerifyInit(NANO_VERIFY* v, NANO_ENGINE engine, long interval, long sample)
+{
+	int i;
+
+	memset(v, 0, sizeof(NANO_VERIFY));
+	v->engine = engine;
+	v->interval = (interval > 0) ? interval : 1;
+	v->sample = (sample > 0) ? sample : 1;
+	for (i = 0; i < 3; ++i)
+	{
+		v->image[i] = (NANO_SHORT*) malloc(NANO_MEM_WORDS * sizeof(NANO_SHORT));
+		if (v->image[i] == NULL)
+		{
+			NanoVerifyFree(v);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void NanoVerifyFree(NANO_VERIFY* v)
+{
+	int i;
+	for (i = 0; i < 3; ++i)
+	{
+		free(v->image[i]);
+		v->image[i] = NULL;
+	}
+	free(v->io);
+	free(v->pages);
+	v->io = NULL;
+	v->pages = NULL;
+	v->ioMax = v->pageMax = 0;
+}
+
+/*
+ *  ===== NanoVerifyRun =====
+ *      Run up to count instructions, checking the fast engine against the
+ *  reference interpreter on sampled intervals.  Stops at the first
+ *  divergence (v->diverged) or when the engine stops at a breakpoint.
+ *  Returns number of instructions executed.
+ */
+long NanoVerifyRun(NANO_VERIFY* v, NANO_CPU* p, long count)
+{
+	long done = 0;
+
+	while (done < count && !v->diverged)
+	{
+		long want = count - done;
+		NANO_CPU start = *p;
+		long n;
+
+		if (want > v->interval)
+			want = v->interval;
+		if ((v->intervals++ % v->sample) != 0)
+		{
+			n = v->engine(p, want);
+		}
+		else
+		{
+			NANO_CPU ref = *p;
+			unsigned long sum;
+
+			MemSaveImage(v->image[IMG_START]);
+			MemClearDirty(0, MEM_SIZE);
+			IoStart(v);
+			n = v->engine(p, want);
+			v->ioMode = IO_OFF;
+			if (IoCheckable(v))
+			{
+				sum = MemChecksum();
+				MemRestoreDirty(v->image[IMG_START]);
+				ReplayBegin(v, 0, 1);
+				NanoRefEngine(&ref, n);
+				ReplayEnd(v);
+				++v->checked;
+				if (!CpuEqual(&ref, p) || MemChecksum() != sum ||
+					v->ioPos != v->ioCount || v->ioDiverged || ClockError(&start, &ref, p))
+				{
+					*p = start;
+					MemLoadImage(v->image[IMG_START]);
+					v->ioDiverged = 0;
+					n = VerifyLocate(v, p, n);
+					v->diverged = 1;
+				}
+			}
+			else
+			{
+				++v->skipped;
+			}
+			IoStop(v);
+		}
+		if (!v->diverged && ClockError(&start, NULL, p))
+		{
+			/* not compared: report the fast engine's interval */
+			v->clockError = VERIFY_FAST_CLOCK;
+			v->diverged = 1;
+			v->located = 0;
+			v->diffs = 0;
+			v->start = start;
+			v->ref = v->fast = *p;
+			v->where = v->retired;
+		}
+		v->retired += n;
+		done += n;
+		if (n < want)
+			break;
+	}
+	return done;
+}
+
+static void ReportWord(FILE* fp, const char* name, unsigned long ref, unsigned long fast)
+{
+	if (ref != fast)
+		fprintf(fp, "  %-6s  ref %04lx  fast %04lx\n", name, ref, fast);
+}
+
+/*
+ *  ===== NanoVerifyReport =====
+ *      Print the differences found at the first divergence.
+ */
+void NanoVerifyReport(const NANO_VERIFY* v, FILE* fp)
+{
+	char szDisAsm[40];
+	int i;
+
+	if (!v->diverged)
+	{
+		fprintf(fp, "verify: ok, %lu instructions, %lu of %lu intervals checked\n",
+			(unsigned long) v->retired, v->checked, v->intervals);
+		if (v->skipped != 0)
+			fprintf(fp, "verify: %lu sampled intervals remapped memory and were not checked\n",
+				v->skipped);
+		return;
+	}
+	if (v->clockError)
+	{
+		fprintf(fp, "verify: engine error: the cycle count of the %s ran backwards\n",
+			(v->clockError == VERIFY_FAST_CLOCK) ? "fast engine" :
+			(v->clockError == VERIFY_REF_CLOCK) ? "reference" : "fast engine and reference");
+	}
+	if (v->located)
+	{
+		NanoGetCore(v->start.bits)->DisAsm(szDisAsm, sizeof(szDisAsm), v->start.pc, v->opc);
+		fprintf(fp, "verify: %s at instruction %lu, pc " NANO_SZADDR ": %04x  %s\n",
+			v->clockError ? "engine error" : "divergence",
+			(unsigned long) v->where, v->start.pc, v->opc, szDisAsm);
+	}
+	else
+	{
+		fprintf(fp, "verify: %s in interval starting at instruction %lu, pc " NANO_SZADDR "\n",
+			v->clockError ? "engine error" : "divergence",
+			(unsigned long) v->where, v->start.pc);
+	}
+	for (i = 0; i < 16; ++i)
+		ReportWord(fp, szRegName[i], v->ref.reg[i], v->fast.reg[i]);
+	ReportWord(fp, "pc", v->ref.pc, v->fast.pc);
+	ReportWord(fp, "ccr", v->ref.ccr, v->fast.ccr);
+	ReportWord(fp, "prefix", v->ref.prefix, v->fast.prefix);
+	if (v->clockError && v->ref.cycles == v->fast.cycles)
+		fprintf(fp, "  cycles  start %lu  after %lu\n",
+			(unsigned long) v->start.cycles, (unsigned long) v->fast.cycles);
+	else if (v->clockError)
+		fprintf(fp, "  cycles  start %lu  ref %lu  fast %lu\n", (unsigned long) v->start.cycles,
+			(unsigned long) v->ref.cycles, (unsigned long) v->fast.cycles);
+	else if (v->ref.cycles != v->fast.cycles)
+		fprintf(fp, "  cycles  ref %lu  fast %lu\n",
+			(unsigned long) v->ref.cycles, (unsigned long) v->fast.cycles);
+	for (i = 0; i < v->diffs && i < VERIFY_MAX_DIFFS; ++i)
+		fprintf(fp, "  [" NANO_SZADDR "]  ref %04x  fast %04x\n",
+			v->diffAddr[i], v->diffRef[i], v->diffFast[i]);
+	if (v->ioDiverged)
+		fprintf(fp, "  device access at " NANO_SZADDR " differs from the fast engine's\n", v->ioAddr);
+	if (v->diffs > VERIFY_MAX_DIFFS)
+		fprintf(fp, "  ... %d more memory words differ\n", v->diffs - VERIFY_MAX_DIFFS);
+}
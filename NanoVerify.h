@@ -0,0 +1,119 @@
+/* nanoverify.h */
+
+#ifndef __NANOVERIFY_H__
+#define __NANOVERIFY_H__
+
+#include <stdio.h>
+#include "NanoMem.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ *  Lockstep co-verification of a fast engine against the reference
+ *  interpreter (NanoSimInst).
+ *
+ *  Every "interval" instructions the fast engine runs from a saved state,
+ *  memory is rewound and the reference interpreter runs the same number
+ *  of instructions.  Registers, pc, ccr, prefix and a memory checksum are
+ *  then compared.  Only every "sample"th interval is checked; the others
+ *  run on the fast engine alone.  On the first mismatch the interval is
+ *  replayed one instruction at a time to locate the diverging instruction.
+ *
+ *  Devices are only driven by the fast engine.  Its device accesses in a
+ *  checked interval are logged, together with any RAM pages an access
+ *  changed (e.g. a DMA transfer); replays then take device reads from the
+ *  log, check device writes against it without performing them, and hold
+ *  the scheduler so no event fires twice.  Output, input and device state
+ *  are therefore exactly those of an unverified run.  Sampled intervals in
+ *  which a device remapped RAM pages (MMU bank switches) cannot be rewound
+ *  and are run without being compared.
+ *
+ *  The reference runs with every page on the bus slow path and polls
+ *  events per instruction, so the check covers the fast engine's run loop
+ *  (event budgets, idle loop skipping, breakpoints) and the inline page
+ *  table accesses.  Both share the instruction decoder (NanoExecInst), so
+ *  decode errors common to both need the co-simulation bridge instead.
+ *  Far memory is not compared.
+ *
+ *  An engine whose cycle count goes backwards (a negative access cost
+ *  added to it) is reported as an engine error rather than a divergence.
+ *  The reference is checked after every instruction, the fast engine
+ *  over each interval, checked or not, and per instruction when an
+ *  interval is located.
+ */
+
+typedef long (*NANO_ENGINE)(NANO_CPU* p, long count);
+
+#define VERIFY_MAX_DIFFS	16
+
+/* Engines whose cycle count ran backwards */
+#define VERIFY_FAST_CLOCK	0x0001
+#define VERIFY_REF_CLOCK	0x0002
+
+/* Logged device access */
+typedef struct
+{
+	NANO_ADDR addr;
+	NANO_SHORT data;		/* value read or written */
+	short write;
+	int result;				/* cycles returned by the handler */
+	long page;				/* first RAM page changed by the access */
+	long pages;				/* number of RAM pages changed */
+} VERIFY_IO;
+
+/* RAM page contents after a device access changed it */
+typedef struct
+{
+	int n;
+	NANO_SHORT words[MEM_PAGE_WORDS];
+} VERIFY_PAGE;
+
+typedef struct
+{
+	NANO_ENGINE engine;		/* fast engine under test */
+	long interval;			/* instructions per interval */
+	long sample;			/* check every Nth interval */
+
+	NANO_TIME retired;		/* instructions executed */
+	unsigned long intervals;	/* intervals executed */
+	unsigned long checked;	/* intervals compared */
+	unsigned long skipped;	/* sampled intervals not compared */
+
+	int diverged;			/* non-zero after a mismatch */
+	NANO_TIME where;		/* instruction number of the mismatch */
+	int located;			/* non-zero if narrowed to one instruction */
+	NANO_INST opc;			/* diverging instruction */
+	NANO_CPU start;			/* state before diverging instruction(s) */
+	NANO_CPU ref;			/* reference state after them */
+	NANO_CPU fast;			/* fast engine state after them */
+	int diffs;				/* number of differing memory words */
+	NANO_ADDR diffAddr[VERIFY_MAX_DIFFS];
+	NANO_SHORT diffRef[VERIFY_MAX_DIFFS];
+	NANO_SHORT diffFast[VERIFY_MAX_DIFFS];
+	int clockError;			/* VERIFY_xxx_CLOCK: an engine error, not a divergence */
+	int ioDiverged;			/* non-zero if device accesses differ */
+	NANO_ADDR ioAddr;		/* first differing device access */
+
+	NANO_SHORT* image[3];	/* scratch memory images */
+	VERIFY_IO* io;			/* device accesses of the checked interval */
+	long ioCount, ioMax, ioPos;
+	VERIFY_PAGE* pages;		/* RAM pages changed by them */
+	long pageCount, pageMax;
+	int ioMode;
+	int ioFull;				/* log could not grow */
+	NANO_SHORT* ram[MEM_PAGES];	/* page backing at start of interval */
+} NANO_VERIFY;
+
+int NanoVerifyInit(NANO_VERIFY* v, NANO_ENGINE engine, long interval, long sample);
+void NanoVerifyFree(NANO_VERIFY* v);
+long NanoVerifyRun(NANO_VERIFY* v, NANO_CPU* p, long count);
+void NanoVerifyReport(const NANO_VERIFY* v, FILE* fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NANOVERIFY_H__ */
@@ -14,11 +14,27 @@
 // For compilers that support precompilation, includes "wx/wx.h".
 #include "wx/wxprec.h"
 
-#include "NanoCpu.h"
+#include "NanoMmu.h"
+#include "NanoDma.h"
+#include "NanoTimer.h"
+#include "NanoGpio.h"
+#include "NanoUart.h"
+#include "NanoPlugin.h"
+#include "NanoVcd.h"
+#include "NanoDisCache.h"
+#include "NanoLoad.h"
 #include <assert.h>
+#include <math.h>
+#include <string.h>
 
-#define NANO_MEM_WORDS	32768		// 32K x 16 (64K Bytes) of Memory
 #define NANO_RAM_WORDS	24576		// 24K x 16 (48K Bytes) of RAM
+#define DIS_PREFETCH_MAX	256		// rows formatted ahead per refresh tick
+#define GUI_REFRESH_MS	50			// peripheral view refresh interval
+#define HUD_REFRESH_MS	500			// status bar rates are averaged over this
+#define HEAT_REFRESH_MS	250			// heatmap shows counts over this
+#define HEAT_COLS		32			// blocks per heatmap row
+#define HEAT_CELL		12			// heatmap block size in pixels
+#define HEAT_MARGIN		40			// room for row addresses
 
 
 #ifndef WX_PRECOMP
@@ -56,6 +72,12 @@ enum
 	ID_DEBUG_STEP_OUT,
 	ID_DEBUG_GO,
 	ID_DEBUG_BREAKPT,
+	ID_DEBUG_BREAK,
+
+	ID_VIEW_HEATMAP = 250,
+
+	ID_TIMER_REFRESH = 300,
+	ID_TIMER_HEAT,
 
 	ID_HELP_ABOUT = wxID_ABOUT
 };
@@ -79,9 +101,15 @@ MENU_ITEM menuDebug[] =
 	{ ID_DEBUG_STEP_OUT,	"Step Out",	"Step Out of the current function" },
 	{ 0,					NULL,			NULL },
 	{ ID_DEBUG_GO,			"Go\tF5",	"Start or continues execution", },
+	{ ID_DEBUG_BREAK,		"Break\tCtrl+B",	"Stop execution" },
 	{ ID_DEBUG_BREAKPT,		"Breakpoint\tF9",	"Insert or remove breakpoint" }
 };
 
+MENU_ITEM menuView[] =
+{
+	{ ID_VIEW_HEATMAP,		"Memory &Heatmap",	"Show reads, writes and fetches per 64 byte block" },
+};
+
 MENU_ITEM menuHelp[] =
 {
 	{ ID_HELP_ABOUT,		"&About Nano Sim",	"Displays program information, version and Copyright" },
@@ -102,11 +130,13 @@ ACCEL_ITEM accelTable[] =
 	{ ID_DEBUG_STEP_OVER, wxACCEL_NORMAL, WXK_F10 },
 	{ ID_DEBUG_GO, wxACCEL_NORMAL, WXK_F5 },
 	{ ID_DEBUG_BREAKPT, wxACCEL_NORMAL, WXK_F9 },
+	{ ID_DEBUG_BREAK, wxACCEL_CTRL, 'B' },
 };
 
 //Constructor, sets up virtual report list with 3 columns
-MemListCtrl::MemListCtrl(wxWindow* parent, int numItems) :
-wxListView(parent, wxID_ANY, wxDefaultPosition, wxSize(200, 100), wxLC_REPORT | wxLC_VIRTUAL | wxLC_SINGLE_SEL){
+MemListCtrl::MemListCtrl(wxWindow* parent, int numItems, const NANO_CORE* core) :
+wxListView(parent, wxID_ANY, wxDefaultPosition, wxSize(200, 100), wxLC_REPORT | wxLC_VIRTUAL | wxLC_SINGLE_SEL),
+m_core(core){
 	// Add first column        
 	wxListItem col0;
 	col0.SetId(0);
@@ -129,25 +159,52 @@ wxListView(parent, wxID_ANY, wxDefaultPosition, wxSize(200, 100), wxLC_REPORT |
 	InsertColumn(2, col2);
 
 	SetItemCount(numItems);
+	DisCacheInit(core);
+}
+
+MemListCtrl::~MemListCtrl()
+{
+	DisCacheFree();
+}
+
+// Redraw the visible rows whose contents changed since they were drawn
+void MemListCtrl::RefreshDirty()
+{
+	long top = GetTopItem();
+	long end = top + GetCountPerPage() + 1;
+	if (end > GetItemCount())
+		end = GetItemCount();
+	for (long item = top; item < end; ++item)
+	{
+		if (DisCacheUpdate((NANO_ADDR) item * 2))
+			RefreshItem(item);
+	}
+}
+
+// Format the rows a page either side of the viewport ahead of scrolling.
+// The visible rows are left to RefreshDirty so their changes get drawn.
+void MemListCtrl::Prefetch()
+{
+	long top = GetTopItem();
+	long rows = GetCountPerPage() + 1;
+	long first = (top > rows) ? top - rows : 0;
+	DisCachePrefetch((NANO_ADDR) first * 2, (NANO_ADDR) top * 2, DIS_PREFETCH_MAX);
+	DisCachePrefetch((NANO_ADDR) (top + rows) * 2, (NANO_ADDR) (top + 2 * rows) * 2, DIS_PREFETCH_MAX);
 }
 
 //Overload virtual method of wxListView to provide text data for virtual list
 wxString MemListCtrl::OnGetItemText(long item, long column) const {
 	wxString str;
-	char szDisAsm[40];
-	NANO_ADDR addr = item * 2;
-	NANO_INST opc;
-	MemReadWord(addr, &opc);
+	const DIS_ENTRY* entry = DisCacheGet(item * 2);
 	switch (column) {
 	case 0:
-		str = str.Format(_("%04x"), addr);
+		str = str.FromAscii(entry->addr);
 		break;
 	case 1:
-		str = str.Format(_("%04x"), opc);
+		str = str.FromAscii(entry->data);
 		break;
 	case 2:
-		NanoDisAsm(szDisAsm, 20, addr, opc);
-		str = str.FromAscii(szDisAsm);
+		str = str.FromAscii(entry->text);
 		break;
 	default:
 		assert("Invalid column");
@@ -167,8 +224,29 @@ bool MyApp::OnInit()
   if ( !wxApp::OnInit() )
       return false;
 
+  // "-32" on the command line selects the 32-bit core, "-mmu" adds the MMU,
+  // "-vcd file" records a waveform, "-mhz n" runs in real time at n MHz
+  int bits = 16;
+  double mhz = 0;
+  wxString vcd;
+  for (int i = 1; i < argc; ++i)
+  {
+      if (argv[i] == "-32")
+          bits = 32;
+      else if (argv[i] == "-mmu")
+          MmuInit();
+      else if (argv[i] == "-vcd" && i + 1 < argc)
+          vcd = argv[++i];
+      else if (argv[i] == "-mhz" && i + 1 < argc)
+          argv[++i].ToDouble(&mhz);
+  }
+
   // Create the main frame window
-  MyFrame *frame = new MyFrame;
+  MyFrame *frame = new MyFrame(bits);
+  if (!vcd.empty() && VcdOpen(vcd.c_str(), bits, 0) < 0)
+      wxMessageBox("Cannot create " + vcd, "ERROR", wxOK | wxCENTRE | wxICON_ERROR);
+  if (mhz > 0)
+      EnginePost(ENGINE_PACE, (unsigned long) (mhz * 1e6));
   frame->SetMinClientSize(wxSize(550, 350));
 
   frame->Show(true);
@@ -176,6 +254,12 @@ bool MyApp::OnInit()
   return true;
 }
 
+int MyApp::OnExit()
+{
+  VcdClose();
+  return wxApp::OnExit();
+}
+
 // ----------------------------------------------------------------------------
 // MyFrame
 // ----------------------------------------------------------------------------
@@ -196,6 +280,13 @@ EVT_MENU(ID_DEBUG_STEP_OVER, MyFrame::OnDebugStepOver)
 EVT_MENU(ID_DEBUG_STEP_INTO, MyFrame::OnDebugStepInto)
 EVT_MENU(ID_DEBUG_STEP_OUT, MyFrame::OnDebugStepOut)
 EVT_MENU(ID_DEBUG_GO, MyFrame::OnDebugGo)
+EVT_MENU(ID_DEBUG_BREAK, MyFrame::OnDebugBreak)
+EVT_MENU(ID_DEBUG_BREAKPT, MyFrame::OnDebugBreakpt)
+// Peripherals
+EVT_COMMAND_RANGE(wxID_CHECK_INP0, wxID_CHECK_INP0 + 15, wxEVT_CHECKBOX, MyFrame::OnCheckBox)
+EVT_TIMER(ID_TIMER_REFRESH, MyFrame::OnTimer)
+// View Menu
+EVT_MENU(ID_VIEW_HEATMAP, MyFrame::OnViewHeatmap)
 
 EVT_MENU(ID_HELP_ABOUT, MyFrame::OnAbout)
 EVT_MENU(ID_FILE_EXIT, MyFrame::OnQuit)
@@ -232,20 +323,29 @@ wxMenu* wxMakeMenu(MENU_ITEM* pMenu, int count)
 MyFrame* myFrame = NULL;
 
 // Define my frame constructor
-MyFrame::MyFrame()
-       : wxFrame(NULL, wxID_ANY, "Nano CPU Simulator")
+MyFrame::MyFrame(int bits)
+       : wxFrame(NULL, wxID_ANY, "Nano CPU Simulator"),
+         m_core(NanoGetCore(bits)),
+         m_shownValid(false),
+         m_highlight(0),
+         m_running(0),
+         m_heat(NULL),
+         m_timer(this, ID_TIMER_REFRESH),
+         m_gpioSeen(gpioChanges)
 {
     SetIcon(wxICON(sample));
 
     // Make a menubar
 	wxMenu *file_menu = wxMakeMenu(menuFile, COUNT(menuFile));
 	wxMenu* debug_menu = wxMakeMenu(menuDebug, COUNT(menuDebug));
+	wxMenu* view_menu = wxMakeMenu(menuView, COUNT(menuView));
 	wxMenu *help_menu = wxMakeMenu(menuHelp, COUNT(menuHelp));
 
     wxMenuBar *menu_bar = new wxMenuBar;
 
     menu_bar->Append(file_menu, "&File");
 	menu_bar->Append(debug_menu, "&Debug");
+	menu_bar->Append(view_menu, "&View");
     menu_bar->Append(help_menu, "&Help");
 
     // Associate the menu bar with the frame
@@ -253,6 +353,8 @@ MyFrame::MyFrame()
 
 #if wxUSE_STATUSBAR
     CreateStatusBar(2);
+    static const int widths[2] = { -1, -2 };	// messages, performance
+    SetStatusWidths(2, widths);
     SetStatusText("Nano Simulator");
 #endif // wxUSE_STATUSBAR
 
@@ -266,7 +368,7 @@ MyFrame::MyFrame()
 
     wxBoxSizer* horizSizer = new wxBoxSizer( wxHORIZONTAL );
 
-	m_memory = new MemListCtrl(p, NANO_MEM_WORDS);
+	m_memory = new MemListCtrl(p, NANO_MEM_WORDS, m_core);
 
     horizSizer->Add(m_memory, wxSizerFlags(1).Expand().Border(wxALL, 5));
     
@@ -329,9 +431,27 @@ MyFrame::MyFrame()
     // the initial size as calculated by the sizers
     topsizer->SetSizeHints( this );
 
-	NanoReset(&m_cpu);
 	myFrame = this;
+	MapDevices();
+	EngineStart(m_core);
+	EngineSnapshot(&m_cpu, &m_hud);
 	UpdateView();
+	m_timer.Start(GUI_REFRESH_MS);
+}
+
+MyFrame::~MyFrame()
+{
+	UartSetSink(NULL, NULL);	// the log window is going away
+	EngineStop();
+}
+
+// Pass a command to the engine thread, wait for it and take a new snapshot
+void MyFrame::Command(ENGINE_CMD cmd, unsigned long arg)
+{
+	while (EnginePost(cmd, arg) < 0)
+		EngineSync();
+	EngineSync();
+	m_running = EngineSnapshot(&m_cpu, NULL);
 }
 
 void NanoFillMemory(int incr)
@@ -345,202 +465,217 @@ void NanoFillMemory(int incr)
 
 void MyFrame::OnFileNew(wxCommandEvent& WXUNUSED(event))
 {
+	Command(ENGINE_BREAK);
 	NanoFillMemory(17);
-	NanoReset(&m_cpu);
-	Refresh();
+	Command(ENGINE_RESET);
+	UpdateView();
 }
 
-// Parse single hex word on a line
-int atohex(const char* buffer, int n)
+// UART output sink: append a batch to the log window
+static void UartLogSink(void* ctx, const char* data, int length)
 {
-	int hex = 0;
-	for (int i = 0; i < n; ++i)
-	{
-		char ch = buffer[i];
-		if (ch == '\n' || ch == '\r' || ch == ' ' || ch == '\0')
-			break;
-		else if (ch >= '0' && ch <= '9')
-			hex = hex * 16 + ch - '0';
-		else if (ch >= 'a' && ch <= 'f')
-			hex = hex * 16 + ch - 'a' + 10;
-		else if (ch >= 'A' && ch <= 'F')
-			hex = hex * 16 + ch - 'A' + 10;
-		else
-			return -1;
-	}
-	return hex;
+	MyFrame* frame = (MyFrame*) ctx;
+	frame->m_log->AppendText(wxString(data, length));
 }
 
-#define UART_STATUS	0xFD01
-#define UART_DATA	0xFD00
-#define GPIO_PORT	0xFE00
+void MyFrame::MapDevices()
+{
+	GpioInit();
+	GpioSetInput(0);		// checkboxes start unchecked
+	UartInit();
+	UartSetSink(UartLogSink, this);
+	UartSetWait(1);			// the engine thread must not call the sink
+	DmaInit();
+	TimerInit();
+	PluginLoadEnv();		// plugins may replace built-in devices
+}
+
+// Show new GPIO outputs; the checkboxes are the pins so they feed the input latch
+void MyFrame::RefreshGpio()
+{
+	unsigned long changes = gpioChanges;
+	if (changes == m_gpioSeen)
+		return;
+	m_gpioSeen = changes;
+	NANO_WORD word = led_out;
+	for (int i = 0; i < 16; ++i)
+		m_iobox[i]->SetValue((word & (1 << i)) ? true : false);
+	EnginePost(ENGINE_INPUT, word);
+}
 
-extern "C" void OutWriteWord(NANO_ADDR addr, NANO_SHORT word)
+void MyFrame::OnCheckBox(wxCommandEvent& WXUNUSED(event))
 {
-	if (myFrame != NULL)
+	NANO_WORD word = 0;
+	for (int i = 0; i < 16; ++i)
 	{
-		switch (addr & 0xFF01)
-		{
-		case GPIO_PORT:
-			for (int i = 0; i < 16; ++i)
-			{
-				bool state = (word & (1 << i)) ? true : false;
-				myFrame->m_iobox[i]->SetValue(state);
-			}
-			break;
-		case UART_DATA:
-			myFrame->m_log->AppendText((char) word);
-			break;
-		default:
-			;
-		}
+		if (m_iobox[i]->IsChecked())
+			word |= (1 << i);
 	}
+	EnginePost(ENGINE_INPUT, word);
 }
 
-extern "C" NANO_WORD InpReadWord(NANO_ADDR addr)
+// Poll the engine's published state at the refresh rate
+void MyFrame::OnTimer(wxTimerEvent& WXUNUSED(event))
 {
-	NANO_WORD w = 0;
-	int i;
-	if (myFrame != NULL)
+	ENGINE_STATS stats;
+	int running = EngineSnapshot(&m_cpu, &stats);
+	if (running || m_running)
 	{
-		switch (addr & 0xFF01)
-		{
-		case GPIO_PORT:
-			for (i = 0; i < 16; ++i) {
-				if (myFrame->m_iobox[i]->IsChecked()) w |= (1 << i);
-			}
-			break;
-		case UART_DATA:
-			w = 0x8100;
-			break;
-		case UART_STATUS:
-			w = 0x81;
-			break;
-		default:
-			w = 0xDEAD;
-		}
+		if (!running)
+			SetStatusText(m_cpu.pc == m_cpu.breakpoint ? "Breakpoint" : "Stopped");
+		m_running = running;
+		UpdateView();
+	}
+	else
+	{
+		m_memory->RefreshDirty();
+		RefreshGpio();
+		UartFlush();
 	}
-	return w;
+	UpdateHud(stats);
+	m_memory->Prefetch();
+}
+
+// Show the engine's run rates in the status bar.  While running they are
+// averaged over HUD_REFRESH_MS; once stopped, any step is shown at once.
+void MyFrame::UpdateHud(const ENGINE_STATS& stats)
+{
+	NANO_USEC us = stats.us - m_hud.us;
+	if (stats.us == m_hud.us || (m_running && us < HUD_REFRESH_MS * 1000))
+		return;
+	double insts = (double) (stats.insts - m_hud.insts);
+	double cycles = (double) (stats.cycles - m_hud.cycles);
+	SetStatusText(wxString::Format("%.2f MIPS  %.2f MHz  %lu cycles  %.2fx real time",
+		insts / us, cycles / us, (unsigned long) m_cpu.cycles,
+		cycles * 1e6 / stats.hz / us), 1);
+	m_hud = stats;
 }
 
 void MyFrame::OnFileOpen(wxCommandEvent& WXUNUSED(event))
 {
 	wxFileDialog* dialog = new wxFileDialog(
 		this, _("Choose a file to open"), wxEmptyString, wxEmptyString,
-		_("Binary Files (*.bin)|*.bin|Hex Files (*.hex)|*.hex"),
+		_("Binary Files (*.bin)|*.bin|Hex Files (*.hex)|*.hex|S-Record Files (*.s19;*.s28;*.s37;*.srec)|*.s19;*.s28;*.s37;*.srec"),
 	wxFD_OPEN, wxDefaultPosition);
 
 	// Creates a "open file" dialog with 4 file types
 	if (dialog->ShowModal() == wxID_OK) // if the user click "Open" instead of "Cancel"
 	{
 		wxString path = dialog->GetPath();
-		NanoFillMemory(0);
-		NanoReset(&m_cpu);
-		NANO_ADDR addr = 0;
-		if (path.EndsWith(".bin"))
-		{
-			FILE* fp = fopen(path, "rb");
-			if (fp != NULL)
-			{
-				int words;
-				do
-				{
-					NANO_WORD buffer[256];
-					words = fread(buffer, sizeof(NANO_WORD), 256, fp);
-					for (int i = 0; i < words; ++i)
-					{
-						MemWriteWord(addr, buffer[i]);
-						addr += 2;
-					}
-				} while (words > 0 && addr < NANO_RAM_WORDS);
-				fclose(fp);
-				Refresh();
-			}
-		}
-		else if (path.EndsWith(".hex"))
-		{
-			FILE* fp = fopen(path, "r");
-			if (fp != NULL)
-			{
-				do
-				{
-					char buffer[256];
-					if (fgets(buffer, 256, fp) == NULL)
-						break;
-
-					int i = atohex(buffer, 256);
-					if (i < 0)
-					{
-						wxString str = str.Format("Error parsing hex at addr %04X", addr);
-						wxMessageBox(str, "ERROR", wxOK | wxCENTRE | wxICON_ERROR);
-					}
-					MemWriteWord(addr, (NANO_WORD)i);
-					addr += 2;
-				} while (addr < NANO_RAM_WORDS);
-				fclose(fp);
-				Refresh();
-			}
-		}
-		else
+		Command(ENGINE_BREAK);
+		MemUnmapFiles();
+		MemFillBlock(0, 0, NANO_RAM_WORDS * 2);
+		int line;
+		int result = LoadImage(path, NANO_RAM_WORDS * 2, &line);
+		if (result < 0)
 		{
-			wxMessageBox("Unknown file extension", "ERROR", wxOK | wxCENTRE | wxICON_ERROR);
+			wxString str = (line > 0) ? wxString::Format("%s line %d: %s", path, line, LoadError(result))
+				: wxString::Format("%s: %s", path, LoadError(result));
+			wxMessageBox(str, "ERROR", wxOK | wxCENTRE | wxICON_ERROR);
 		}
+		Command(ENGINE_RESET);
+		UpdateView();
 	}
 
 	// Clean up after ourselves
 	dialog->Destroy();
 }
 
+// Show a register's text if it changed; changes since the last view are highlighted
+void MyFrame::ShowRegister(int id, const char* text, bool changed)
+{
+	unsigned long bit = 1UL << id;
+	if (changed || !m_shownValid)
+		m_register[id]->SetValue(text);
+	changed = changed && m_shownValid;
+	if (changed != ((m_highlight & bit) != 0))
+	{
+		m_register[id]->SetForegroundColour(changed ? *wxRED : wxNullColour);
+		m_register[id]->Refresh();
+		m_highlight ^= bit;
+	}
+}
+
+// Bring the view up to m_cpu, touching only what differs from the last view
 void MyFrame::UpdateView(void)
 {
 	char szValue[10];
 	for (int i = 0; i < 16; ++i)
 	{
-		sprintf(szValue, "%04x", m_cpu.reg[i]);
-		m_register[i]->SetValue(szValue);
+		sprintf(szValue, m_core->szWord, m_cpu.reg[i]);
+		ShowRegister(i, szValue, m_cpu.reg[i] != m_shown.reg[i]);
 	}
-	sprintf(szValue, "%04x", m_cpu.prefix);
-	m_register[16]->SetValue(szValue);
+	sprintf(szValue, m_core->szWord, m_cpu.prefix);
+	ShowRegister(ID_IMM, szValue, m_cpu.prefix != m_shown.prefix);
 	NANO_WORD ccr = m_cpu.ccr;
 	sprintf(szValue, "%c %c %c %c",
 		(ccr & NANO_N) ? 'N' : '-',
 		(ccr & NANO_C) ? 'C' : '-',
 		(ccr & NANO_V) ? 'V' : '-',
 		(ccr & NANO_Z) ? 'Z' : '-');
-	m_register[17]->SetValue(szValue);
-	long index = m_cpu.pc >> 1;
-	m_memory->Select(index);
-	m_memory->Focus(index);
+	ShowRegister(ID_CCR, szValue, ccr != m_shown.ccr);
+	if (!m_shownValid || m_cpu.pc != m_shown.pc)
+	{
+		long index = m_cpu.pc >> 1;
+		m_memory->Select(index);
+		m_memory->Focus(index);
+	}
+	m_memory->RefreshDirty();
+	RefreshGpio();
+	UartFlush();
 
-	Refresh();
+	m_shown = m_cpu;
+	m_shownValid = true;
 }
 
 void MyFrame::OnDebugStepOver(wxCommandEvent& WXUNUSED(event))
 {
-	NanoSimInst(&m_cpu, NANO_STEP_OVER);
+	Command(ENGINE_STEP, NANO_STEP_OVER);
 	UpdateView();
 }
 
 void MyFrame::OnDebugStepInto(wxCommandEvent& WXUNUSED(event))
 {
-	NanoSimInst(&m_cpu, NANO_STEP_INTO);
+	Command(ENGINE_STEP, NANO_STEP_INTO);
 	UpdateView();
 }
 
 void MyFrame::OnDebugStepOut(wxCommandEvent& WXUNUSED(event))
 {
-	NanoSimInst(&m_cpu, NANO_STEP_OUT);
+	Command(ENGINE_STEP, NANO_STEP_OUT);
 	UpdateView();
 }
 
+// Run on the engine thread until a breakpoint or Break; the timer shows progress
 void MyFrame::OnDebugGo(wxCommandEvent& WXUNUSED(event))
 {
-	// TODO: Fix this - for now just step 1000 instructions!
-	for (int i = 0; i < 10000; ++i)
+	Command(ENGINE_GO);
+	SetStatusText("Running");
+}
+
+void MyFrame::OnDebugBreak(wxCommandEvent& WXUNUSED(event))
+{
+	Command(ENGINE_BREAK);
+	UpdateView();
+}
+
+// Toggle the breakpoint at the selected instruction
+void MyFrame::OnDebugBreakpt(wxCommandEvent& WXUNUSED(event))
+{
+	long index = m_memory->GetFirstSelected();
+	if (index < 0)
+		return;
+	NANO_ADDR addr = (NANO_ADDR) index * 2;
+	if (addr == m_cpu.breakpoint)
 	{
-		NanoSimInst(&m_cpu, NANO_STEP_INTO);
+		Command(ENGINE_BREAKPOINT, ENGINE_NO_BREAK);
+		SetStatusText("Breakpoint removed");
+	}
+	else
+	{
+		Command(ENGINE_BREAKPOINT, addr);
+		SetStatusText(wxString::Format("Breakpoint at %04x", addr));
 	}
-	UpdateView();
 }
 	
 void MyFrame::OnQuit(wxCommandEvent& WXUNUSED(event))
@@ -550,6 +685,123 @@ void MyFrame::OnQuit(wxCommandEvent& WXUNUSED(event))
 
 void MyFrame::OnAbout(wxCommandEvent& WXUNUSED(event) )
 {
-    (void)wxMessageBox("Nano 16-bit CPU Simulator.\n",
+    (void)wxMessageBox(wxString::Format("Nano %d-bit CPU Simulator.\n", m_core->bits),
             "About Nano Simulator", wxOK|wxICON_INFORMATION);
 }
+
+// Open the heatmap, counting accesses only while it is open
+void MyFrame::OnViewHeatmap(wxCommandEvent& WXUNUSED(event))
+{
+	if (m_heat != NULL)
+	{
+		m_heat->Raise();
+		return;
+	}
+	Command(ENGINE_HEAT, 1);
+	m_heat = new HeatFrame(this);
+	m_heat->Show(true);
+}
+
+void MyFrame::HeatClosed()
+{
+	Command(ENGINE_HEAT, 0);
+	m_heat = NULL;
+}
+
+// ----------------------------------------------------------------------------
+// HeatFrame
+// ----------------------------------------------------------------------------
+
+wxBEGIN_EVENT_TABLE(HeatFrame, wxFrame)
+EVT_TIMER(ID_TIMER_HEAT, HeatFrame::OnTimer)
+EVT_CLOSE(HeatFrame::OnClose)
+wxEND_EVENT_TABLE()
+
+HeatFrame::HeatFrame(wxWindow* parent)
+       : wxFrame(parent, wxID_ANY, "Memory Heatmap"),
+         m_timer(this, ID_TIMER_HEAT),
+         m_max(0)
+{
+	memset(m_last, 0, sizeof(m_last));
+	memset(m_rate, 0, sizeof(m_rate));
+	m_panel = new wxPanel(this, wxID_ANY);
+	m_panel->SetBackgroundStyle(wxBG_STYLE_PAINT);
+	m_panel->Bind(wxEVT_PAINT, &HeatFrame::OnPaint, this);
+	m_panel->Bind(wxEVT_MOTION, &HeatFrame::OnMotion, this);
+#if wxUSE_STATUSBAR
+	CreateStatusBar(1);
+	SetStatusText("Red: writes  Green: reads  Blue: fetches");
+#endif // wxUSE_STATUSBAR
+	SetClientSize(HEAT_MARGIN + HEAT_COLS * HEAT_CELL, MEM_HEAT_BLOCKS / HEAT_COLS * HEAT_CELL);
+	m_timer.Start(HEAT_REFRESH_MS);
+}
+
+// Take the counts since the last tick
+void HeatFrame::OnTimer(wxTimerEvent& WXUNUSED(event))
+{
+	m_max = 0;
+	for (int kind = 0; kind < MEM_HEAT_KINDS; ++kind)
+	{
+		const volatile unsigned long* counts = MemHeatCounts(kind);
+		for (int i = 0; i < MEM_HEAT_BLOCKS; ++i)
+		{
+			unsigned long count = counts[i];
+			m_rate[kind][i] = count - m_last[kind][i];
+			m_last[kind][i] = count;
+			if (m_rate[kind][i] > m_max)
+				m_max = m_rate[kind][i];
+		}
+	}
+	m_panel->Refresh(false);
+}
+
+// Colour level for a count: logarithmic, so quiet blocks still show
+static unsigned char HeatLevel(unsigned long count, double scale)
+{
+	if (count == 0)
+		return 0;
+	return (unsigned char) (64 + 191 * log(1.0 + count) * scale);
+}
+
+void HeatFrame::OnPaint(wxPaintEvent& WXUNUSED(event))
+{
+	wxPaintDC dc(m_panel);
+	double scale = m_max ? 1.0 / log(1.0 + m_max) : 0.0;
+	dc.SetBackground(*wxBLACK_BRUSH);
+	dc.Clear();
+	dc.SetTextForeground(*wxWHITE);
+	dc.SetFont(*wxSMALL_FONT);
+	dc.SetPen(*wxTRANSPARENT_PEN);
+	for (int i = 0; i < MEM_HEAT_BLOCKS; ++i)
+	{
+		int x = HEAT_MARGIN + (i % HEAT_COLS) * HEAT_CELL;
+		int y = (i / HEAT_COLS) * HEAT_CELL;
+		if (i % HEAT_COLS == 0 && (i / HEAT_COLS) % 2 == 0)
+			dc.DrawText(wxString::Format("%04x", i << MEM_HEAT_SHIFT), 2, y);
+		wxColour colour(HeatLevel(m_rate[MEM_HEAT_WRITE][i], scale),
+			HeatLevel(m_rate[MEM_HEAT_READ][i], scale),
+			HeatLevel(m_rate[MEM_HEAT_EXEC][i], scale));
+		dc.SetBrush(wxBrush(colour));
+		dc.DrawRectangle(x, y, HEAT_CELL - 1, HEAT_CELL - 1);
+	}
+}
+
+// Show the totals of the block under the mouse
+void HeatFrame::OnMotion(wxMouseEvent& event)
+{
+	int col = (event.GetX() - HEAT_MARGIN) / HEAT_CELL;
+	int row = event.GetY() / HEAT_CELL;
+	if (event.GetX() < HEAT_MARGIN || col >= HEAT_COLS || row * HEAT_COLS >= MEM_HEAT_BLOCKS)
+		return;
+	int i = row * HEAT_COLS + col;
+	SetStatusText(wxString::Format("%04x-%04x  R %lu  W %lu  X %lu",
+		i << MEM_HEAT_SHIFT, ((i + 1) << MEM_HEAT_SHIFT) - 1,
+		m_last[MEM_HEAT_READ][i], m_last[MEM_HEAT_WRITE][i], m_last[MEM_HEAT_EXEC][i]));
+}
+
+void HeatFrame::OnClose(wxCloseEvent& WXUNUSED(event))
+{
+	m_timer.Stop();
+	myFrame->HeatClosed();
+	Destroy();
+}
@@ -8,7 +8,8 @@
 // Licence:     wxWindows licence
 /////////////////////////////////////////////////////////////////////////////
 
-#include "NanoCpu.h"
+#include "NanoMem.h"
+#include "NanoEngine.h"
 
 #ifndef wxOVERRIDE
 #define wxOVERRIDE
@@ -20,6 +21,7 @@ class MyApp: public wxApp
 public:
     MyApp(){}
     bool OnInit() wxOVERRIDE;
+    int OnExit() wxOVERRIDE;
 };
 
 typedef enum id_regs
@@ -33,18 +35,47 @@ typedef enum id_regs
 class MemListCtrl : public wxListView
 {
 public:
-	MemListCtrl(wxWindow* parent, int numitems);
+	MemListCtrl(wxWindow* parent, int numitems, const NANO_CORE* core);
+	~MemListCtrl();
 	wxString OnGetItemText(long item, long column) const;
+	void RefreshDirty();
+	void Prefetch();
+private:
+	const NANO_CORE* m_core;
 };
 
 extern class MyFrame* myFrame;
 
+// live view of memory traffic per MEM_HEAT_SIZE block
+class HeatFrame : public wxFrame
+{
+public:
+	HeatFrame(wxWindow* parent);
+	void OnTimer(wxTimerEvent& event);
+	void OnPaint(wxPaintEvent& event);
+	void OnMotion(wxMouseEvent& event);
+	void OnClose(wxCloseEvent& event);
+private:
+	wxPanel* m_panel;
+	wxTimer m_timer;
+	unsigned long m_last[MEM_HEAT_KINDS][MEM_HEAT_BLOCKS];	// totals at last tick
+	unsigned long m_rate[MEM_HEAT_KINDS][MEM_HEAT_BLOCKS];	// counts during last tick
+	unsigned long m_max;
+    wxDECLARE_EVENT_TABLE();
+};
+
 // the main frame class
 class MyFrame : public wxFrame
 {
 	void UpdateView();
+	void ShowRegister(int id, const char* text, bool changed);
+	void MapDevices();
+	void RefreshGpio();
+	void UpdateHud(const ENGINE_STATS& stats);
+	void Command(ENGINE_CMD cmd, unsigned long arg = 0);
 public:
-	MyFrame();
+	MyFrame(int bits);
+	~MyFrame();
 	// File Menu
 	void OnFileNew(wxCommandEvent& event);
 	void OnFileOpen(wxCommandEvent& event);
@@ -54,6 +85,14 @@ public:
 	void OnDebugStepInto(wxCommandEvent& event);
 	void OnDebugStepOut(wxCommandEvent& event);
 	void OnDebugGo(wxCommandEvent& event);
+	void OnDebugBreak(wxCommandEvent& event);
+	void OnDebugBreakpt(wxCommandEvent& event);
+	// Peripherals
+	void OnCheckBox(wxCommandEvent& event);
+	void OnTimer(wxTimerEvent& event);
+	// View Menu
+	void OnViewHeatmap(wxCommandEvent& event);
+	void HeatClosed();
 	// Help Menu
 	void OnAbout(wxCommandEvent& event);
     void OnQuit(wxCommandEvent& event);
@@ -63,6 +102,15 @@ public:
 	wxCheckBox* m_iobox[16];
 	wxTextCtrl* m_log;
 private:
-	NANO_CPU m_cpu;
+	const NANO_CORE* m_core;
+	NANO_CPU m_cpu;			// snapshot of the engine's CPU
+	NANO_CPU m_shown;		// state the view last showed
+	bool m_shownValid;
+	unsigned long m_highlight;	// registers shown as changed, bit per ID_REGS
+	int m_running;
+	HeatFrame* m_heat;
+	wxTimer m_timer;
+	unsigned long m_gpioSeen;
+	ENGINE_STATS m_hud;		// counters at the last status bar update
     wxDECLARE_EVENT_TABLE();
 };
@@ -33,26 +33,40 @@
 #include "HexFile.h"
 #include <stdlib.h>
 
+#define XX  HEX_ERROR
+
+/* Value of every character as a hex digit, HEX_ERROR if it is not one */
+const signed char hexDigit[256] =
+{
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, XX, XX, XX, XX, XX, XX,
+    XX, 10, 11, 12, 13, 14, 15, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, 10, 11, 12, 13, 14, 15, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX
+};
+
+#undef XX
+
 /*
  *  ===== ParseHexDigit =====
- *  Parse a string of hex digits ('0123456789ABCDEF') into
- *  a 8/16-bit value.
+ *  Parse a hex digit ('0123456789ABCDEF') into a 4-bit value.
  *
  *  Returns HEX_ERROR (-1) for error else valid number
  */
 int ParseHexDigit(const char ch)
 {
-    int digit;
-
-    if (ch >= '0' && ch <= '9')
-        digit = (ch - '0');
-    else if (ch >= 'a' && ch <= 'f')
-        digit = (ch - 'a') + 10;
-    else if (ch >= 'A' && ch <= 'F')
-        digit = (ch - 'A') + 10;
-    else
-        digit = HEX_ERROR;
-    return digit;
+    return hexDigit[(unsigned char) ch];
 }
 
 /*
@@ -63,12 +77,12 @@ int ParseHexDigit(const char ch)
  */
 int ParseHexByte(const char *line)
 {
-    int lo,hi;
+    int hi = hexDigit[(unsigned char) line[0]];
+    int lo;
 
-    hi = ParseHexDigit(line[0]);
     if (hi < 0)
         return hi;
-    lo = ParseHexDigit(line[1]);
+    lo = hexDigit[(unsigned char) line[1]];
     if (lo < 0)
         return lo;
     return (hi << 4) | lo;
@@ -91,6 +91,11 @@ typedef enum hex_result
     HEX_ABORT = 3,
 } HEX_RESULT;
 
+/**
+ *	Hex digit value of each ASCII character, HEX_ERROR (-1) for non digits.
+ */
+extern const signed char hexDigit[256];
+
 /**
  *	This function parses an ASCII character into hex digit.
  *
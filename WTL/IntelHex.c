@@ -83,10 +83,8 @@ int ParseIntelHex(const char * line, HEX_RECORD* hexrec)
         hexrec->addr = hexrec->base + offset;
         break;
     case 2:
-        hexrec->base = (HEX_ADDR) offset << 4;
-        break;
     case 4:
-        /* extended hex record: read data bytes as offset */
+        /* extended segment / linear address: read data bytes as offset */
         for (i = 0; i < count; ++i)
         {
             result = ParseHexByte(line);
@@ -97,7 +95,7 @@ int ParseIntelHex(const char * line, HEX_RECORD* hexrec)
             chksum += result;
         }
         count = 0;
-        hexrec->base = (HEX_ADDR) offset << 16;
+        hexrec->base = (HEX_ADDR) offset << ((type == 2) ? 4 : 16);
     default:
         ;
     }
@@ -148,7 +146,7 @@ int WriteIntelHex(FILE* fout, void* buf, HEX_ADDR offset, int count)
     {
         unsigned int block = offset >> 16;
         chksum = 0xFA - (block & 255) - (block >> 8);
-        result = fprintf(fout, ":02000004%04X%02X\n", offset >> 16, chksum & 255);
+        result = fprintf(fout, ":02000004%04X%02X\n", (unsigned) (offset >> 16), chksum & 255);
     }
 
     /* Output length and offset */
@@ -121,14 +121,14 @@ unsigned long ParseLong(char* pText, BOOL* bError, int base)
     return l;
 }
 
-BOOL CNanoSimView::GetDlgWord(UINT id, NANO_WORD* pWord, BOOL bHex)
+BOOL CNanoSimView::GetDlgWord(UINT id, NANO_REG* pWord, BOOL bHex)
 {
     char szText[80];
 	BOOL result = GetDlgItemText(id, szText, sizeof(szText));
 	if (result)
     {
         BOOL bError;
-        NANO_WORD w = ParseLong(szText, &bError, bHex ? 16 : 10);
+        NANO_REG w = ParseLong(szText, &bError, bHex ? 16 : 10);
         if (!bError)
             *pWord = w;
 	}
@@ -35,7 +35,7 @@ protected:
 	void GetView(void);
 	void SetView(void);
     NANO_CPU m_cpu;
-    BOOL CNanoSimView::GetDlgWord(UINT id, NANO_WORD* w, BOOL bHex);
+    BOOL CNanoSimView::GetDlgWord(UINT id, NANO_REG* w, BOOL bHex);
 	BOOL SetDlgWord(UINT id, NANO_WORD w, BOOL bHex);
     CListBox m_list;
 };
@@ -1,4 +1,4 @@
-#include "hexfile.h"
+#include "SRecord.h"
 #include <stdlib.h>
 
 /**
@@ -43,13 +43,13 @@ static int ParseSRecordLine(int addrbytes, const char * line, HEX_RECORD* hexrec
 {
     int i, count, chksum;
 
-    /* Read byte count (2 digits) */
+    /* Read byte count (2 digits): address, data and checksum bytes */
     int result = ParseHexByte(line);
-    if (result < 5)
+    if (result < addrbytes + 1)
         return HEX_LENGTH_ERROR;
     line += 2;
     chksum = result;
-    hexrec->length = count = result - 5;
+    hexrec->length = count = result - addrbytes - 1;
 
     /* Read address (2-4 bytes) */
     hexrec->addr = 0;
@@ -95,6 +95,13 @@ int ParseMotorolaSRecord(const char * line, HEX_RECORD* hexrec)
     ch = *line++;
     type = ch - '0';
     switch (ch) {
+        case '0':
+        case '5':
+        case '6':
+            /* header and record count: checked but not loaded */
+            i = ParseSRecordLine((type == 6) ? 3 : 2, line, hexrec);
+            return (i >= 0) ? HEX_OTHER : i;
+
         case '1':
         case '2':
         case '3':
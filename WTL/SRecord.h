@@ -70,8 +70,11 @@ extern "C"
  *  Note 1: Checksum is computed as one's complement of eight bit sum of all
  *          values from 'nn' to end of data.
  *
- *  Note 2: Count 'nn' is three greater than the number of data bytes in the
- *          record.
+ *  Note 2: Count 'nn' is the number of address, data and checksum bytes,
+ *          i.e. three greater than the number of data bytes of an S1.
+ *
+ *  Note 3: S0 headers and S5/S6 record counts are verified and return
+ *          HEX_OTHER.
  *
  *	@param	line containing Motorola S-Record ASCII character string
  *  @param  record Hex record to write to
@@ -83,4 +86,4 @@ int ParseMotorolaSRecord(const char * line, HEX_RECORD* record);
 }
 #endif
 
-#endif /* __HEXFILE_H__ */
+#endif /* __SRECORD_H__ */